@@ -0,0 +1,264 @@
+/*
+  EdgeCapture - recordings of the raw edges seen by a receiver, see EdgeCapture.h
+*/
+
+#include "EdgeCapture.h"
+#include <string.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+
+static const char captureMagic[4] = { 'R', 'C', 'E', 'C' };
+
+EdgeCaptureWriter::EdgeCaptureWriter() {
+  this->file = NULL;
+  this->nPin = -1;
+  this->nClockSource = EDGE_CLOCK_MICROS;
+  this->bStarted = false;
+  this->lastTime = 0;
+}
+
+EdgeCaptureWriter::~EdgeCaptureWriter() {
+  this->close();
+}
+
+/**
+ * Creates (or truncates) a capture file. The header is written with the first edge.
+ *
+ * @param path          File to write
+ * @param nPin          Receiver pin, for the header
+ * @param nClockSource  EDGE_CLOCK_MICROS or EDGE_CLOCK_KERNEL
+ *
+ * @return false if the file can not be created
+ */
+bool EdgeCaptureWriter::open(const char* path, int nPin, int nClockSource) {
+  this->close();
+  this->file = fopen(path, "wb");
+  this->nPin = nPin;
+  this->nClockSource = nClockSource;
+  this->bStarted = false;
+  return this->file != NULL;
+}
+
+void EdgeCaptureWriter::writeEdge(const RCSwitchEdge& edge) {
+  if (this->file == NULL) {
+    return;
+  }
+
+  if (!this->bStarted) {
+    unsigned char header[EDGE_CAPTURE_HEADER];
+    unsigned long long start = edge.time;
+    memcpy(header, captureMagic, 4);
+    header[4] = EDGE_CAPTURE_VERSION;
+    header[5] = this->nClockSource;
+    header[6] = this->nPin;
+    header[7] = edge.level;
+    for (int i = 0; i < 8; i++) {
+      header[8 + i] = start >> (8 * i);
+    }
+    fwrite(header, 1, EDGE_CAPTURE_HEADER, this->file);
+    this->bStarted = true;
+    this->lastTime = edge.time;
+    return;
+  }
+
+  // same wrap around safe difference as the decoder uses
+  unsigned long duration = edge.time - this->lastTime;
+  this->lastTime = edge.time;
+
+  unsigned char bytes[10];
+  int count = 0;
+  do {
+    bytes[count] = duration & 0x7F;
+    duration >>= 7;
+    if (duration != 0) {
+      bytes[count] |= 0x80;
+    }
+    count++;
+  } while (duration != 0);
+  fwrite(bytes, 1, count, this->file);
+}
+
+void EdgeCaptureWriter::flush() {
+  if (this->file != NULL) {
+    fflush(this->file);
+  }
+}
+
+void EdgeCaptureWriter::close() {
+  if (this->file != NULL) {
+    fclose(this->file);
+    this->file = NULL;
+  }
+}
+
+
+EdgeCaptureReader::EdgeCaptureReader() {
+  this->fd = -1;
+  this->nBuffered = 0;
+  this->nPosition = 0;
+  this->bEof = true;
+  memset(this->header, 0, EDGE_CAPTURE_HEADER);
+}
+
+EdgeCaptureReader::~EdgeCaptureReader() {
+  this->close();
+}
+
+/**
+ * Reads from fd until count bytes arrived or the end of the input; a pipe may deliver less per read().
+ */
+static size_t readFully(int fd, unsigned char* buffer, size_t count) {
+  size_t total = 0;
+  while (total < count) {
+    ssize_t n = ::read(fd, buffer + total, count - total);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      break;
+    }
+    total += n;
+  }
+  return total;
+}
+
+/**
+ * Opens a capture and checks its header. The capture may also be a named pipe
+ * another process is still writing: read() then waits for the edges as they come.
+ *
+ * @return false if the file can not be read or is not a capture this code understands
+ */
+bool EdgeCaptureReader::open(const char* path) {
+  this->close();
+  this->fd = ::open(path, O_RDONLY);
+  if (this->fd < 0) {
+    return false;
+  }
+  if (readFully(this->fd, this->header, EDGE_CAPTURE_HEADER) != EDGE_CAPTURE_HEADER
+      || memcmp(this->header, captureMagic, 4) != 0 || this->header[4] != EDGE_CAPTURE_VERSION) {
+    this->close();
+    return false;
+  }
+  this->nBuffered = 0;
+  this->nPosition = 0;
+  this->bEof = false;
+  return true;
+}
+
+void EdgeCaptureReader::close() {
+  if (this->fd >= 0) {
+    ::close(this->fd);
+    this->fd = -1;
+  }
+  this->bEof = true;
+}
+
+int EdgeCaptureReader::getPin() {
+  return this->header[6];
+}
+
+int EdgeCaptureReader::getClockSource() {
+  return this->header[5];
+}
+
+int EdgeCaptureReader::getFirstLevel() {
+  return this->header[7];
+}
+
+unsigned long long EdgeCaptureReader::getStartTime() {
+  unsigned long long start = 0;
+  for (int i = 7; i >= 0; i--) {
+    start = (start << 8) | this->header[8 + i];
+  }
+  return start;
+}
+
+/**
+ * Moves the unread bytes to the front of the buffer and reads more after them.
+ * Takes whatever one read() returns, so a pipe is not waited on until the buffer is full.
+ *
+ * @return false if there is nothing left at all
+ */
+bool EdgeCaptureReader::fill() {
+  unsigned int remaining = this->nBuffered - this->nPosition;
+  memmove(this->buffer, this->buffer + this->nPosition, remaining);
+  this->nBuffered = remaining;
+  this->nPosition = 0;
+  while (!this->bEof) {
+    ssize_t count = ::read(this->fd, this->buffer + remaining, sizeof(this->buffer) - remaining);
+    if (count < 0 && errno == EINTR) {
+      continue;
+    }
+    if (count <= 0) {
+      this->bEof = true;
+    } else {
+      this->nBuffered += count;
+    }
+    break;
+  }
+  return this->nBuffered > 0;
+}
+
+/**
+ * True if the buffer holds the whole next varint.
+ */
+bool EdgeCaptureReader::hasVarint() {
+  for (unsigned int i = this->nPosition; i < this->nBuffered && i < this->nPosition + 10; i++) {
+    if ((this->buffer[i] & 0x80) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * Decodes the next edge durations.
+ *
+ * @param durations     Where to store the durations, in microseconds
+ * @param maxDurations  Capacity of durations
+ *
+ * @return number of durations stored, 0 at the end of the capture. Waits for
+ *         more input only when nothing at all could be decoded.
+ */
+unsigned int EdgeCaptureReader::read(unsigned int* durations, unsigned int maxDurations) {
+  unsigned int count = 0;
+
+  while (count < maxDurations) {
+    // a varint is at most 10 bytes: refill before one could be cut in half.
+    // A pipe may hand over part of one (the writer flushes a stdio buffer):
+    // keep reading, without consuming it, until the rest comes
+    if (!this->hasVarint()) {
+      if (count > 0) {
+        break;
+      }
+      while (!this->bEof && !this->hasVarint()) {
+        this->fill();
+      }
+      if (!this->hasVarint()) {
+        // end of the capture: a truncated last edge is dropped
+        this->nPosition = this->nBuffered;
+        break;
+      }
+    }
+
+    unsigned long long duration = 0;
+    unsigned int shift = 0;
+    unsigned char byte;
+    do {
+      if (this->nPosition >= this->nBuffered) {
+        // a corrupt capture: more than 10 bytes without the last one of a varint
+        return count;
+      }
+      byte = this->buffer[this->nPosition++];
+      if (shift < 64) {
+        duration |= (unsigned long long)(byte & 0x7F) << shift;
+      }
+      shift += 7;
+    } while (byte & 0x80);
+
+    durations[count++] = duration > UINT_MAX ? UINT_MAX : (unsigned int)duration;
+  }
+  return count;
+}
@@ -0,0 +1,90 @@
+/*
+  EdgeCapture - recordings of the raw edges seen by a receiver.
+
+  A capture lets us re-run the decoder on exactly what the radio heard, without
+  the radio: RFRcvCmplxData records one when given a file name, RCReplay plays
+  it back through RCSwitchDecoder.
+
+  File layout, integers little endian:
+
+    offset  size  field
+         0     4  magic "RCEC"
+         4     1  format version (EDGE_CAPTURE_VERSION)
+         5     1  clock source of the timestamps (EDGE_CLOCK_*)
+         6     1  receiver pin (wiringPi numbering)
+         7     1  pin level after the first edge
+         8     8  time of the first edge, microseconds on the clock source
+        16   ...  for every following edge, the microseconds since the previous
+                  one (the duration of one signal level) as an unsigned LEB128
+                  varint: 7 bits per byte, low bits first, high bit set on all
+                  but the last byte. Typical pulses fit in 2 bytes.
+*/
+#ifndef _EdgeCapture_h
+#define _EdgeCapture_h
+
+#include <stdio.h>
+#include "RCSwitchDecoder.h"
+
+#define EDGE_CAPTURE_VERSION 1
+#define EDGE_CAPTURE_HEADER 16
+
+#define EDGE_CLOCK_MICROS 0     // wiringPi micros(), read in the interrupt handler
+#define EDGE_CLOCK_KERNEL 1     // kernel timestamp of the GPIO character device event
+
+/**
+ * One signal change, as the edge source (see EdgeSource.h) reported it.
+ */
+struct RCSwitchEdge {
+    unsigned long time;     // when the edge was seen, in microseconds on the source's EDGE_CLOCK_* clock
+    int level;              // pin level after the edge
+};
+
+
+class EdgeCaptureWriter {
+
+  public:
+    EdgeCaptureWriter();
+    ~EdgeCaptureWriter();
+
+    bool open(const char* path, int nPin, int nClockSource);
+    void writeEdge(const RCSwitchEdge& edge);
+    void flush();
+    void close();
+
+  private:
+    FILE* file;
+    int nPin;
+    int nClockSource;
+    bool bStarted;
+    unsigned long lastTime;
+};
+
+
+class EdgeCaptureReader {
+
+  public:
+    EdgeCaptureReader();
+    ~EdgeCaptureReader();
+
+    bool open(const char* path);
+    unsigned int read(unsigned int* durations, unsigned int maxDurations);
+    void close();
+
+    int getPin();
+    int getClockSource();
+    int getFirstLevel();
+    unsigned long long getStartTime();
+
+  private:
+    bool fill();
+    bool hasVarint();
+
+    int fd;
+    unsigned char header[EDGE_CAPTURE_HEADER];
+    unsigned char buffer[65536];
+    unsigned int nBuffered;
+    unsigned int nPosition;
+    bool bEof;
+};
+
+#endif
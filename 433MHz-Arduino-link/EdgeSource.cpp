@@ -0,0 +1,304 @@
+/*
+  EdgeSource - where a receiver gets its edges from, see EdgeSource.h
+*/
+
+#include "EdgeSource.h"
+#include <wiringPi.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <poll.h>
+#include <errno.h>
+#include <sys/ioctl.h>
+#include <linux/gpio.h>
+#include <thread>
+#include <chrono>
+
+/**
+ * The GPIO character device when the kernel provides it, wiringPi otherwise.
+ *
+ * @param nPin  wiringPi pin number; wiringPiSetup() must have been called
+ *
+ * @return NULL if the pin is out of 0..RCSWITCH_MAX_PINS-1
+ */
+EdgeSource* EdgeSource::forPin(int nPin) {
+  if (nPin < 0 || nPin >= RCSWITCH_MAX_PINS) {
+    return NULL;
+  }
+  int gpio = wpiPinToGpio(nPin);
+  if (gpio >= 0) {
+    GpioEdgeSource* source = new GpioEdgeSource(EDGE_GPIO_CHIP, gpio, nPin);
+    if (source->start()) {
+      return source;
+    }
+    delete source;
+  }
+  return new WiringPiEdgeSource(nPin);
+}
+
+
+std::atomic<WiringPiEdgeSource*> WiringPiEdgeSource::sources[RCSWITCH_MAX_PINS];
+
+/**
+ * The interrupt handler of pin PIN: forwards the edge to that pin's source.
+ */
+template <unsigned int PIN>
+void WiringPiEdgeSource::pinInterrupt() {
+  WiringPiEdgeSource* source = WiringPiEdgeSource::sources[PIN].load(std::memory_order_acquire);
+  if (source != NULL) {
+    source->handleInterrupt();
+  }
+}
+
+/**
+ * Instantiates pinInterrupt for pins 0..PIN-1 into a table indexed by pin.
+ */
+template <unsigned int PIN>
+struct WiringPiInterrupts {
+  static void fill(void (**handlers)(void)) {
+    handlers[PIN - 1] = &WiringPiEdgeSource::pinInterrupt<PIN - 1>;
+    WiringPiInterrupts<PIN - 1>::fill(handlers);
+  }
+};
+
+template <>
+struct WiringPiInterrupts<0> {
+  static void fill(void (**)(void)) {
+  }
+};
+
+WiringPiEdgeSource::WiringPiEdgeSource(int nPin) : nDroppedEdges(0) {
+  this->nPin = nPin;
+}
+
+/**
+ * Installs the interrupt handler of the pin. wiringPi can not remove it again,
+ * so a pin can have only one WiringPiEdgeSource for the life of the process.
+ */
+bool WiringPiEdgeSource::start() {
+  static void (*handlers[RCSWITCH_MAX_PINS])(void);
+  static std::once_flag filled;
+  std::call_once(filled, &WiringPiInterrupts<RCSWITCH_MAX_PINS>::fill, handlers);
+
+  if (this->nPin < 0 || this->nPin >= RCSWITCH_MAX_PINS) {
+    return false;
+  }
+  WiringPiEdgeSource* expected = NULL;
+  if (!WiringPiEdgeSource::sources[this->nPin].compare_exchange_strong(expected, this, std::memory_order_acq_rel)) {
+    return false;
+  }
+  return wiringPiISR(this->nPin, INT_EDGE_BOTH, handlers[this->nPin]) >= 0;
+}
+
+/**
+ * Runs in the wiringPi interrupt thread of the pin: only timestamp the edge and queue it.
+ */
+void WiringPiEdgeSource::handleInterrupt() {
+  RCSwitchEdge edge;
+  edge.time = micros();
+  edge.level = digitalRead(this->nPin);
+  if (!this->edges.push(edge)) {
+    this->nDroppedEdges.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+int WiringPiEdgeSource::read(RCSwitchEdge* edges, unsigned int maxEdges) {
+  unsigned int count = 0;
+  while (count < maxEdges && this->edges.pop(edges[count])) {
+    count++;
+  }
+  if (count == 0) {
+    // nothing queued: even the shortest packet takes several ms on air
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  return count;
+}
+
+int WiringPiEdgeSource::getClockSource() {
+  return EDGE_CLOCK_MICROS;
+}
+
+int WiringPiEdgeSource::getPin() {
+  return this->nPin;
+}
+
+unsigned long WiringPiEdgeSource::getDroppedEdges() {
+  return this->nDroppedEdges.load(std::memory_order_relaxed);
+}
+
+
+/**
+ * @param chip   GPIO chip device, e.g. EDGE_GPIO_CHIP
+ * @param nLine  Line offset on the chip (the BCM GPIO number on a Raspberry Pi)
+ * @param nPin   wiringPi pin number of the line, for captures
+ */
+GpioEdgeSource::GpioEdgeSource(const char* chip, unsigned int nLine, int nPin) : nDroppedEdges(0) {
+  this->chip = chip;
+  this->nLine = nLine;
+  this->nPin = nPin;
+  this->fd = -1;
+  this->nLastSeqno = 0;
+}
+
+GpioEdgeSource::~GpioEdgeSource() {
+  if (this->fd >= 0) {
+    close(this->fd);
+  }
+}
+
+/**
+ * Requests the line as an input reporting both edges, timestamped on CLOCK_MONOTONIC.
+ *
+ * @return false if the chip is missing, the line is in use or the kernel headers predate the v2 API
+ */
+bool GpioEdgeSource::start() {
+#ifdef GPIO_V2_GET_LINE_IOCTL
+  if (this->fd >= 0) {
+    return true;
+  }
+  int chipFd = open(this->chip, O_RDONLY | O_CLOEXEC);
+  if (chipFd < 0) {
+    return false;
+  }
+  struct gpio_v2_line_request request;
+  memset(&request, 0, sizeof(request));
+  request.offsets[0] = this->nLine;
+  request.num_lines = 1;
+  strncpy(request.consumer, "rcswitch", sizeof(request.consumer) - 1);
+  request.config.flags = GPIO_V2_LINE_FLAG_INPUT | GPIO_V2_LINE_FLAG_EDGE_RISING | GPIO_V2_LINE_FLAG_EDGE_FALLING;
+  request.event_buffer_size = RCSWITCH_EDGE_BUFFER;
+  int result = ioctl(chipFd, GPIO_V2_GET_LINE_IOCTL, &request);
+  close(chipFd);
+  if (result < 0) {
+    return false;
+  }
+  this->fd = request.fd;
+  return true;
+#else
+  return false;
+#endif
+}
+
+/**
+ * Reads every event the kernel has queued, up to maxEdges, in one read().
+ * Waits at most 100ms for the first one.
+ */
+int GpioEdgeSource::read(RCSwitchEdge* edges, unsigned int maxEdges) {
+#ifdef GPIO_V2_GET_LINE_IOCTL
+  if (this->fd < 0) {
+    return -1;
+  }
+  struct pollfd event;
+  event.fd = this->fd;
+  event.events = POLLIN;
+  int ready = poll(&event, 1, 100);
+  if (ready <= 0) {
+    return ready < 0 && errno != EINTR ? -1 : 0;
+  }
+
+  struct gpio_v2_line_event events[64];
+  if (maxEdges > sizeof(events) / sizeof(events[0])) {
+    maxEdges = sizeof(events) / sizeof(events[0]);
+  }
+  ssize_t size = ::read(this->fd, events, maxEdges * sizeof(events[0]));
+  if (size < 0) {
+    return errno == EINTR || errno == EAGAIN ? 0 : -1;
+  }
+
+  int count = size / sizeof(events[0]);
+  for (int i = 0; i < count; i++) {
+    edges[i].time = events[i].timestamp_ns / 1000;
+    edges[i].level = events[i].id == GPIO_V2_LINE_EVENT_RISING_EDGE ? 1 : 0;
+    if (this->nLastSeqno != 0 && events[i].line_seqno - this->nLastSeqno > 1) {
+      this->nDroppedEdges.fetch_add(events[i].line_seqno - this->nLastSeqno - 1, std::memory_order_relaxed);
+    }
+    this->nLastSeqno = events[i].line_seqno;
+  }
+  return count;
+#else
+  return -1;
+#endif
+}
+
+int GpioEdgeSource::getClockSource() {
+  return EDGE_CLOCK_KERNEL;
+}
+
+int GpioEdgeSource::getPin() {
+  return this->nPin;
+}
+
+unsigned long GpioEdgeSource::getDroppedEdges() {
+  return this->nDroppedEdges.load(std::memory_order_relaxed);
+}
+
+
+/**
+ * @param path  Capture file or named pipe (see EdgeCapture.h), kept until start()
+ */
+FileEdgeSource::FileEdgeSource(const char* path) {
+  this->path = path;
+  this->bFirst = true;
+  this->time = 0;
+  this->level = 0;
+}
+
+/**
+ * Opens the input. For a pipe this waits until the writer has sent the header.
+ */
+bool FileEdgeSource::start() {
+  if (!this->reader.open(this->path)) {
+    return false;
+  }
+  this->bFirst = true;
+  this->time = this->reader.getStartTime();
+  this->level = this->reader.getFirstLevel();
+  return true;
+}
+
+/**
+ * Rebuilds the edges from the durations: the level toggles on every edge.
+ */
+int FileEdgeSource::read(RCSwitchEdge* edges, unsigned int maxEdges) {
+  unsigned int durations[256];
+  unsigned int count = 0;
+
+  if (maxEdges == 0) {
+    return 0;
+  }
+  if (this->bFirst) {
+    edges[count].time = this->time;
+    edges[count].level = this->level;
+    count++;
+    this->bFirst = false;
+  }
+
+  unsigned int want = maxEdges - count;
+  if (want > sizeof(durations) / sizeof(durations[0])) {
+    want = sizeof(durations) / sizeof(durations[0]);
+  }
+  unsigned int read = want > 0 ? this->reader.read(durations, want) : 0;
+  if (read == 0 && count == 0) {
+    return -1;
+  }
+  for (unsigned int i = 0; i < read; i++) {
+    this->time += durations[i];
+    this->level ^= 1;
+    edges[count].time = this->time;
+    edges[count].level = this->level;
+    count++;
+  }
+  return count;
+}
+
+int FileEdgeSource::getClockSource() {
+  return this->reader.getClockSource();
+}
+
+int FileEdgeSource::getPin() {
+  return this->reader.getPin();
+}
+
+unsigned long FileEdgeSource::getDroppedEdges() {
+  return 0;
+}
@@ -0,0 +1,140 @@
+/*
+  EdgeSource - where a receiver gets its edges from.
+
+  An RCSwitchReceiver only needs a stream of timestamped pin level changes;
+  the source decides how they are captured:
+
+  - GpioEdgeSource: the Linux GPIO character device (/dev/gpiochipN). The
+    kernel timestamps every edge in its interrupt handler and queues it, the
+    decoder thread reads them in batches. Pulse widths carry no user space
+    wake-up jitter, and one read() returns many edges.
+  - WiringPiEdgeSource: wiringPiISR(). The handler runs on a wiringPi thread
+    and reads micros() when it gets scheduled, so every edge is late by the
+    scheduling delay, which is what the wide default tolerance absorbs.
+  - FileEdgeSource: a capture file or a named pipe in the EdgeCapture format,
+    to run the receiver, and the programs built on it, without a radio.
+
+  EdgeSource::forPin() picks the character device when the kernel has it and
+  falls back to wiringPi.
+*/
+#ifndef _EdgeSource_h
+#define _EdgeSource_h
+
+#include <atomic>
+#include "RingBuffer.h"
+#include "EdgeCapture.h"
+
+// Number of edges buffered between the interrupt handler and the decoder thread
+// (must be a power of two). At ~350us per pulse 512 edges is well over 100ms of signal.
+#define RCSWITCH_EDGE_BUFFER 512
+
+// wiringPi pin numbers that can receive: 0..RCSWITCH_MAX_PINS-1
+#define RCSWITCH_MAX_PINS 64
+
+// GPIO chip the receiver pins are on
+#define EDGE_GPIO_CHIP "/dev/gpiochip0"
+
+
+class EdgeSource {
+
+  public:
+    virtual ~EdgeSource() {}
+
+    /**
+     * Starts delivering edges.
+     *
+     * @return false if the source can not be used
+     */
+    virtual bool start() = 0;
+
+    /**
+     * Takes the next edges, oldest first. Called from the decoder thread only;
+     * may wait a short while for edges to arrive.
+     *
+     * @param edges     Where to store the edges
+     * @param maxEdges  Capacity of edges
+     *
+     * @return number of edges stored, 0 if none arrived yet, -1 if the source has ended
+     */
+    virtual int read(RCSwitchEdge* edges, unsigned int maxEdges) = 0;
+
+    // EDGE_CLOCK_* of the edge timestamps
+    virtual int getClockSource() = 0;
+    // wiringPi pin number, -1 if not a pin
+    virtual int getPin() = 0;
+    // edges lost before they reached read()
+    virtual unsigned long getDroppedEdges() = 0;
+
+    static EdgeSource* forPin(int nPin);
+};
+
+
+class WiringPiEdgeSource : public EdgeSource {
+
+  public:
+    WiringPiEdgeSource(int nPin);
+
+    bool start();
+    int read(RCSwitchEdge* edges, unsigned int maxEdges);
+    int getClockSource();
+    int getPin();
+    unsigned long getDroppedEdges();
+
+  private:
+    void handleInterrupt();
+    template <unsigned int PIN> static void pinInterrupt();
+    template <unsigned int PIN> friend struct WiringPiInterrupts;
+
+    int nPin;
+    // the interrupt handler only pushes edges here
+    RingBuffer<RCSwitchEdge, RCSWITCH_EDGE_BUFFER> edges;
+    std::atomic<unsigned long> nDroppedEdges;
+
+    // wiringPiISR() passes no context: the handler of each pin finds its source here
+    static std::atomic<WiringPiEdgeSource*> sources[RCSWITCH_MAX_PINS];
+};
+
+
+class GpioEdgeSource : public EdgeSource {
+
+  public:
+    GpioEdgeSource(const char* chip, unsigned int nLine, int nPin);
+    ~GpioEdgeSource();
+
+    bool start();
+    int read(RCSwitchEdge* edges, unsigned int maxEdges);
+    int getClockSource();
+    int getPin();
+    unsigned long getDroppedEdges();
+
+  private:
+    const char* chip;
+    unsigned int nLine;
+    int nPin;
+    int fd;
+    // the kernel numbers the events of a line: a gap means its event queue overflowed
+    unsigned int nLastSeqno;
+    std::atomic<unsigned long> nDroppedEdges;
+};
+
+
+class FileEdgeSource : public EdgeSource {
+
+  public:
+    FileEdgeSource(const char* path);
+
+    bool start();
+    int read(RCSwitchEdge* edges, unsigned int maxEdges);
+    int getClockSource();
+    int getPin();
+    unsigned long getDroppedEdges();
+
+  private:
+    const char* path;
+    EdgeCaptureReader reader;
+    bool bFirst;
+    unsigned long long time;
+    int level;
+};
+
+#endif
@@ -0,0 +1,78 @@
+/*
+  FrameCheck - the optional CRC at the end of a frame.
+
+  A checked frame is the payload followed by a CRC-8 of the payload
+  (polynomial x^8 + x^2 + x + 1, initial value 0, most significant bit first),
+  e.g. the 32 bits of a sensor reading become a 40 bit frame. The Arduino
+  sketch computes it bit by bit (crc8() in RF_433MHz_Send_complex.ino); here a
+  256 entry table, built at compile time, handles a byte per step.
+
+  RCSwitchDecoder::setCheckedBitlength() tells the decoder which frame length
+  carries the CRC: those frames are verified before they are queued, the
+  corrupt ones are counted and dropped, the good ones lose the CRC.
+*/
+#ifndef _FrameCheck_h
+#define _FrameCheck_h
+
+#define FRAME_CHECK_BITS 8
+#define FRAME_CHECK_POLY 0x07
+
+/**
+ * CRC of every byte value, for a CRC of 0 so far
+ */
+struct FrameCheckTable {
+  unsigned char entries[256];
+
+  constexpr FrameCheckTable() : entries() {
+    for (unsigned int n = 0; n < 256; n++) {
+      unsigned int crc = n;
+      for (int bit = 0; bit < 8; bit++) {
+        crc = crc & 0x80 ? (crc << 1) ^ FRAME_CHECK_POLY : crc << 1;
+      }
+      this->entries[n] = (unsigned char)crc;
+    }
+  }
+};
+
+inline constexpr FrameCheckTable frameCheckTable;
+
+
+struct FrameCheck {
+
+  /**
+   * CRC of the nBits low bits of payload, first one most significant
+   *
+   * @param nBits  at most 64 - FRAME_CHECK_BITS, so there is room for the CRC
+   */
+  static constexpr unsigned char crc8(unsigned long long payload, unsigned int nBits) {
+    unsigned int crc = 0;
+    // the bits that do not fill a byte go one at a time, then byte by byte
+    for (; nBits % 8 != 0; nBits--) {
+      bool top = ((crc >> 7) ^ (payload >> (nBits - 1))) & 1;
+      crc = ((crc << 1) & 0xFF) ^ (top ? FRAME_CHECK_POLY : 0);
+    }
+    for (; nBits > 0; nBits -= 8) {
+      crc = frameCheckTable.entries[crc ^ ((payload >> (nBits - 8)) & 0xFF)];
+    }
+    return (unsigned char)crc;
+  }
+
+  /**
+   * The frame to send for a payload: the payload, then its CRC
+   */
+  static constexpr unsigned long long append(unsigned long long payload, unsigned int nBits) {
+    return payload << FRAME_CHECK_BITS | crc8(payload, nBits);
+  }
+
+  /**
+   * True if the last FRAME_CHECK_BITS of a received frame are the CRC of the bits before them
+   *
+   * @param nBits  Length of the frame, CRC included
+   */
+  static constexpr bool verify(unsigned long long frame, unsigned int nBits) {
+    return nBits > FRAME_CHECK_BITS
+        && crc8(frame >> FRAME_CHECK_BITS, nBits - FRAME_CHECK_BITS) == (frame & ((1 << FRAME_CHECK_BITS) - 1));
+  }
+};
+
+#endif
@@ -0,0 +1,73 @@
+/*
+  FrameDedup - drops sensor readings that were already forwarded, see FrameDedup.h
+*/
+
+#include "FrameDedup.h"
+
+FrameDedup::FrameDedup() {
+  for (unsigned int s = 0; s < DEDUP_MAX_STATIONS; s++) {
+    for (unsigned int k = 0; k < DEDUP_MAX_KINDS; k++) {
+      this->entries[s][k].value = 0;
+      this->entries[s][k].acceptedAt = 0;
+      this->entries[s][k].valid = false;
+    }
+  }
+  for (unsigned int k = 0; k < DEDUP_MAX_KINDS; k++) {
+    this->windows[k] = DEDUP_DEFAULT_WINDOW * 1000ULL;
+    this->nSuppressed[k] = 0;
+  }
+}
+
+/**
+ * How long a value of a kind is remembered after it was let through
+ *
+ * @param nKind          0..DEDUP_MAX_KINDS-1
+ * @param nMilliseconds  0 lets every value through
+ */
+void FrameDedup::setWindow(unsigned int nKind, unsigned int nMilliseconds) {
+  if (nKind < DEDUP_MAX_KINDS) {
+    this->windows[nKind] = nMilliseconds * 1000ULL;
+  }
+}
+
+/**
+ * True if the same station sent the same value of this kind less than the
+ * kind's window ago; otherwise the value is remembered as the last one let through.
+ *
+ * @param nStation    Station code, 0..DEDUP_MAX_STATIONS-1
+ * @param nKind       Kind of reading, 0..DEDUP_MAX_KINDS-1
+ * @param value       The reading
+ * @param receivedAt  CLOCK_MONOTONIC microseconds, see RCSwitchFrame
+ *
+ * @return false for a station or kind out of range: those are never suppressed
+ */
+bool FrameDedup::isDuplicate(unsigned int nStation, unsigned int nKind, unsigned long long value,
+                             unsigned long long receivedAt) {
+  if (nStation >= DEDUP_MAX_STATIONS || nKind >= DEDUP_MAX_KINDS) {
+    return false;
+  }
+  Entry& entry = this->entries[nStation][nKind];
+  if (entry.valid && entry.value == value && receivedAt - entry.acceptedAt < this->windows[nKind]) {
+    this->nSuppressed[nKind]++;
+    return true;
+  }
+  entry.value = value;
+  entry.acceptedAt = receivedAt;
+  entry.valid = true;
+  return false;
+}
+
+/**
+ * Number of duplicates suppressed, all kinds
+ */
+unsigned long FrameDedup::getSuppressed() {
+  unsigned long count = 0;
+  for (unsigned int k = 0; k < DEDUP_MAX_KINDS; k++) {
+    count += this->nSuppressed[k];
+  }
+  return count;
+}
+
+unsigned long FrameDedup::getSuppressed(unsigned int nKind) {
+  return nKind < DEDUP_MAX_KINDS ? this->nSuppressed[nKind] : 0;
+}
@@ -0,0 +1,52 @@
+/*
+  FrameDedup - drops sensor readings that were already forwarded.
+
+  An Arduino repeats its reading, and the same reading can come in again a
+  little later (a second burst, a second receiver pin). Each (station, kind)
+  pair, e.g. station 3's DHT readings and station 3's PIR readings, keeps the
+  last value it let through and when: the same value again within that kind's
+  window is a duplicate. Stations that transmit in between do not disturb each
+  other, and a fixed table of DEDUP_MAX_STATIONS x DEDUP_MAX_KINDS entries makes
+  every lookup O(1) without allocating.
+
+  Times are the CLOCK_MONOTONIC microseconds of RCSwitchFrame::receivedAt, so
+  the windows are real time however long the main loop sleeps or blocks.
+  Meant for the main loop's thread only.
+*/
+#ifndef _FrameDedup_h
+#define _FrameDedup_h
+
+// station codes 0..15: the first 4 bits of a sensor frame
+#define DEDUP_MAX_STATIONS 16
+
+// kinds of reading a station can send
+#define DEDUP_MAX_KINDS 4
+
+// window of a kind until setWindow() is called for it, in milliseconds
+#define DEDUP_DEFAULT_WINDOW 30000
+
+
+class FrameDedup {
+
+  public:
+    FrameDedup();
+
+    void setWindow(unsigned int nKind, unsigned int nMilliseconds);
+    bool isDuplicate(unsigned int nStation, unsigned int nKind, unsigned long long value,
+                     unsigned long long receivedAt);
+    unsigned long getSuppressed();
+    unsigned long getSuppressed(unsigned int nKind);
+
+  private:
+    struct Entry {
+      unsigned long long value;
+      unsigned long long acceptedAt;    // microseconds, when value was last let through
+      bool valid;
+    };
+
+    Entry entries[DEDUP_MAX_STATIONS][DEDUP_MAX_KINDS];
+    unsigned long long windows[DEDUP_MAX_KINDS];    // microseconds
+    unsigned long nSuppressed[DEDUP_MAX_KINDS];
+};
+
+#endif
@@ -0,0 +1,182 @@
+/*
+  HammingCode - forward error correction for frames (extended Hamming, SECDED).
+
+  nDataBits data bits get r parity bits, 2^r >= nDataBits + r + 1, plus one
+  parity bit over everything: 32 bits become 39, 40 (32 and a CRC-8) become 47,
+  at most 57 fit in a 64 bit frame. Any two codes differ in at least 4 bits, so
+  the receiver can:
+  - correct one wrong bit and tell two wrong bits from a good frame, or
+  - fill in up to two bits it could not read at all (a pulse pair that matched
+    neither shape) from a single repeat, instead of waiting for the majority
+    vote over several repeats.
+
+  Bit layout, first bit sent first: the classic Hamming positions 1..N-1 (parity
+  at the powers of two, data in between, first data bit first), then the overall
+  parity. The Arduino sketch has the same encoder (hammingEncode() in
+  RF_433MHz_Send_complex.ino).
+*/
+#ifndef _HammingCode_h
+#define _HammingCode_h
+
+// most data bits that fit in a 64 bit frame
+#define HAMMING_MAX_DATA_BITS 57
+
+struct HammingCode {
+
+  /**
+   * Number of Hamming parity bits for nDataBits, without the overall parity
+   */
+  static constexpr unsigned int parityBits(unsigned int nDataBits) {
+    unsigned int r = 0;
+    while ((1u << r) < nDataBits + r + 1) {
+      r++;
+    }
+    return r;
+  }
+
+  /**
+   * Length of the frame sent for nDataBits
+   */
+  static constexpr unsigned int codedBits(unsigned int nDataBits) {
+    return nDataBits + parityBits(nDataBits) + 1;
+  }
+
+  /**
+   * Data bits carried by a frame of nCodedBits, 0 if no data length codes to it
+   */
+  static constexpr unsigned int dataBits(unsigned int nCodedBits) {
+    for (unsigned int n = 1; n <= HAMMING_MAX_DATA_BITS; n++) {
+      if (codedBits(n) == nCodedBits) {
+        return n;
+      }
+    }
+    return 0;
+  }
+
+  /**
+   * The frame to send for the nDataBits low bits of data
+   */
+  static constexpr unsigned long long encode(unsigned long long data, unsigned int nDataBits) {
+    const unsigned int n = codedBits(nDataBits);
+    unsigned long long code = 0;
+    unsigned int syndrome = 0;
+    for (unsigned int p = 1; p < n; p++) {
+      if ((p & (p - 1)) != 0 && (data >> --nDataBits) & 1) {
+        code |= 1ULL << (n - p);
+        syndrome ^= p;
+      }
+    }
+    // the parity bits make the syndrome of the whole frame 0
+    for (unsigned int p = 1; p < n; p <<= 1) {
+      if (syndrome & p) {
+        code |= 1ULL << (n - p);
+      }
+    }
+    return code | (__builtin_popcountll(code) & 1);
+  }
+
+  /**
+   * XOR of the positions of the bits that are set: 0 for a good frame,
+   * the position of the wrong bit if one is wrong
+   */
+  static constexpr unsigned int syndrome(unsigned long long code, unsigned int nCodedBits) {
+    unsigned int syndrome = 0;
+    for (unsigned int p = 1; p < nCodedBits; p++) {
+      if ((code >> (nCodedBits - p)) & 1) {
+        syndrome ^= p;
+      }
+    }
+    return syndrome;
+  }
+
+  /**
+   * The data bits of a frame
+   */
+  static constexpr unsigned long long extract(unsigned long long code, unsigned int nCodedBits) {
+    unsigned long long data = 0;
+    for (unsigned int p = 1; p < nCodedBits; p++) {
+      if ((p & (p - 1)) != 0) {
+        data = (data << 1) | ((code >> (nCodedBits - p)) & 1);
+      }
+    }
+    return data;
+  }
+
+  /**
+   * Bits at the start of a frame that hold its first nDataBits data bits,
+   * parity bits in between included
+   */
+  static constexpr unsigned int leadingBits(unsigned int nDataBits) {
+    unsigned int p = 0;
+    while (nDataBits > 0) {
+      p++;
+      if ((p & (p - 1)) != 0) {
+        nDataBits--;
+      }
+    }
+    return p;
+  }
+
+  /**
+   * The data bits of the first nLeadingBits bits of a frame, see leadingBits()
+   */
+  static constexpr unsigned long long extractLeading(unsigned long long bits, unsigned int nLeadingBits) {
+    // as if the overall parity bit followed them
+    return extract(bits << 1, nLeadingBits + 1);
+  }
+
+  /**
+   * Corrects a received frame.
+   *
+   * @param code        The frame; receives the corrected frame
+   * @param nCodedBits  Its length
+   * @param erased      The bits that could not be read (their value in code does not matter):
+   *                    at most 2, filled in only if that gives a good frame as it is
+   * @param data        Receives the data bits
+   *
+   * @return number of bits corrected or filled in, -1 if the frame can not be corrected
+   */
+  static constexpr int decode(unsigned long long& code, unsigned int nCodedBits, unsigned long long erased,
+                              unsigned long long* data) {
+    if (erased != 0) {
+      if (__builtin_popcountll(erased) > 2) {
+        return -1;
+      }
+      // only one filling can be a good frame: two good frames differ in at least 4 bits
+      for (unsigned long long fill = erased; ; fill = (fill - 1) & erased) {
+        unsigned long long candidate = (code & ~erased) | fill;
+        if (syndrome(candidate, nCodedBits) == 0 && (__builtin_popcountll(candidate) & 1) == 0) {
+          code = candidate;
+          *data = extract(code, nCodedBits);
+          return __builtin_popcountll(erased);
+        }
+        if (fill == 0) {
+          return -1;
+        }
+      }
+    }
+
+    unsigned int position = syndrome(code, nCodedBits);
+    bool odd = __builtin_popcountll(code) & 1;
+    int corrected = 0;
+    if (position != 0 && odd) {
+      // one wrong bit, at position
+      if (position >= nCodedBits) {
+        return -1;
+      }
+      code ^= 1ULL << (nCodedBits - position);
+      corrected = 1;
+    } else if (odd) {
+      // only the overall parity bit is wrong
+      code ^= 1;
+      corrected = 1;
+    } else if (position != 0) {
+      // an even number of wrong bits: at least two
+      return -1;
+    }
+    *data = extract(code, nCodedBits);
+    return corrected;
+  }
+};
+
+#endif
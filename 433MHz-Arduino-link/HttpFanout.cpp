@@ -0,0 +1,396 @@
+/*
+  HttpFanout - posts the readings to the web services from one curl multi loop, see HttpFanout.h
+*/
+
+#include "HttpFanout.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <thread>
+
+// curl_multi_poll() and curl_multi_wakeup() came with libcurl 7.68
+#ifndef HTTP_HAS_WAKEUP
+#define HTTP_HAS_WAKEUP (LIBCURL_VERSION_NUM >= 0x074400)
+#endif
+
+// the clock of SensorRecord::receivedAt, in microseconds
+static unsigned long long monotonicMicros() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec * 1000000ULL + now.tv_nsec / 1000;
+}
+
+HttpFanout::HttpFanout() {
+  this->multi = curl_multi_init();
+  this->jsonHeaders = curl_slist_append(NULL, "Content-Type: application/json");
+  this->nServices = 0;
+}
+
+/**
+ * Adds a web service, before start().
+ *
+ * @param sName      Name for the statistics; not copied
+ * @param url        Writes the URL for a reading
+ * @param check      Tells from the response whether the reading was accepted; NULL if any response will do
+ * @param nCapacity  Readings that can wait for the service
+ * @param nPolicy    SINK_DROP_OLDEST, SINK_DROP_NEWEST or SINK_BLOCK when they are all taken
+ *
+ * @return the sink to push the readings to, NULL if there are HTTP_MAX_SERVICES already
+ */
+SensorSink* HttpFanout::addService(const char* sName, UrlBuilder url, ResponseCheck check,
+                                   unsigned int nCapacity, int nPolicy) {
+  Service* service = this->newService(sName, check, nCapacity, nPolicy);
+  if (service == NULL) {
+    return NULL;
+  }
+  service->url = url;
+  return service->sink;
+}
+
+/**
+ * Adds a web service that takes several readings in one POST, before start().
+ *
+ * @param sName        Name for the statistics; not copied
+ * @param batch        Writes the URL and body for the readings at the front of a batch
+ * @param check        Tells from the response whether the readings were accepted; NULL if any response will do
+ * @param nBatch       Readings that are posted together, at most HTTP_MAX_BATCH
+ * @param nMaxLatency  Milliseconds after it was received the oldest reading is posted, however few there are
+ * @param nCapacity    Readings that can wait for the service, besides the batch
+ * @param nPolicy      SINK_DROP_OLDEST, SINK_DROP_NEWEST or SINK_BLOCK when they are all taken
+ *
+ * @return the sink to push the readings to, NULL if there are HTTP_MAX_SERVICES already
+ */
+SensorSink* HttpFanout::addBatchService(const char* sName, BatchBuilder batch, ResponseCheck check,
+                                        unsigned int nBatch, unsigned int nMaxLatency,
+                                        unsigned int nCapacity, int nPolicy) {
+  Service* service = this->newService(sName, check, nCapacity, nPolicy);
+  if (service == NULL) {
+    return NULL;
+  }
+  service->batch = batch;
+  service->nBatch = nBatch < 1 ? 1 : nBatch > HTTP_MAX_BATCH ? HTTP_MAX_BATCH : nBatch;
+  service->maxLatency = nMaxLatency * 1000ULL;
+  return service->sink;
+}
+
+HttpFanout::Service* HttpFanout::newService(const char* sName, ResponseCheck check,
+                                            unsigned int nCapacity, int nPolicy) {
+  if (this->nServices >= HTTP_MAX_SERVICES) {
+    return NULL;
+  }
+  Service& service = this->services[this->nServices++];
+  service.sink = SensorSink::createQueue(sName, nCapacity, nPolicy);
+  service.check = check;
+  service.nBatch = 1;
+  service.maxLatency = 0;
+  service.rateInterval = 0;
+  service.rateBurst = 1;
+  service.credit = 0;
+  service.refilledAt = 0;
+  service.curl = NULL;
+  service.busy = false;
+  service.nRecords = 0;
+  service.nSending = 0;
+  service.responseLength = 0;
+  service.latency = HttpLatency { 0, 0, 0, 0, 0 };
+  service.totalTime = 0;
+#if HTTP_HAS_WAKEUP
+  // a reading for an idle service: get the loop out of curl_multi_poll()
+  CURLM* multi = this->multi;
+  service.sink->setWakeup([multi] {
+    if (multi != NULL) {
+      curl_multi_wakeup(multi);
+    }
+  });
+#endif
+  return &service;
+}
+
+/**
+ * Limits how often a service is sent a request, before start().
+ *
+ * @param sink       One of this fan-out's services
+ * @param nInterval  Milliseconds it takes a token to come back
+ * @param nBurst     Requests that can go out back to back after a quiet time, at least 1
+ *
+ * @return false if the sink is not one of this fan-out's services
+ */
+bool HttpFanout::setRateLimit(SensorSink* sink, unsigned int nInterval, unsigned int nBurst) {
+  for (unsigned int i = 0; i < this->nServices; i++) {
+    Service& service = this->services[i];
+    if (service.sink == sink) {
+      service.rateInterval = nInterval * 1000ULL;
+      service.rateBurst = nBurst < 1 ? 1 : nBurst;
+      // full from the start
+      service.credit = service.rateInterval * service.rateBurst;
+      service.refilledAt = monotonicMicros();
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * Creates the curl handles and starts the thread posting the readings.
+ *
+ * @return false if curl could not be set up: the readings then wait in the
+ *         queues until they are dropped
+ */
+bool HttpFanout::start() {
+  if (this->multi == NULL) {
+    return false;
+  }
+  for (unsigned int i = 0; i < this->nServices; i++) {
+    Service& service = this->services[i];
+    service.curl = curl_easy_init();
+    if (service.curl == NULL) {
+      return false;
+    }
+    curl_easy_setopt(service.curl, CURLOPT_PRIVATE, &service);
+    // in case it is redirected, tell libcurl to follow redirection
+    curl_easy_setopt(service.curl, CURLOPT_FOLLOWLOCATION, 1L);
+    curl_easy_setopt(service.curl, CURLOPT_WRITEFUNCTION, HttpFanout::receive);
+    curl_easy_setopt(service.curl, CURLOPT_WRITEDATA, &service);
+    curl_easy_setopt(service.curl, CURLOPT_CONNECTTIMEOUT_MS, (long)HTTP_CONNECT_TIMEOUT);
+    curl_easy_setopt(service.curl, CURLOPT_TIMEOUT_MS, (long)HTTP_TIMEOUT);
+    curl_easy_setopt(service.curl, CURLOPT_TCP_KEEPALIVE, 1L);
+    // no signals for the timeouts, we have threads
+    curl_easy_setopt(service.curl, CURLOPT_NOSIGNAL, 1L);
+    if (service.batch) {
+      curl_easy_setopt(service.curl, CURLOPT_HTTPHEADER, this->jsonHeaders);
+    }
+  }
+  std::thread worker(&HttpFanout::run, this);
+  pthread_setname_np(worker.native_handle(), "http");
+  worker.detach();
+  return true;
+}
+
+/**
+ * Requests a service finished and their times so far.
+ *
+ * @return false if the sink is not one of this fan-out's services
+ */
+bool HttpFanout::getLatency(SensorSink* sink, HttpLatency& latency) {
+  std::lock_guard<std::mutex> lock(this->latencyMutex);
+  for (unsigned int i = 0; i < this->nServices; i++) {
+    if (this->services[i].sink == sink) {
+      latency = this->services[i].latency;
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * curl write callback: keeps the start of the response, the rest is read and ignored
+ */
+size_t HttpFanout::receive(char* ptr, size_t size, size_t nmemb, void* userdata) {
+  Service* service = (Service*)userdata;
+  size_t length = size * nmemb;
+  size_t room = HTTP_RESPONSE_SIZE - 1 - service->responseLength;
+  size_t kept = length < room ? length : room;
+  memcpy(service->response + service->responseLength, ptr, kept);
+  service->responseLength += kept;
+  service->response[service->responseLength] = '\0';
+  return length;
+}
+
+/**
+ * Thread: starts a request for every idle service with a reading (or a batch)
+ * due, then sleeps until a transfer needs attention, one finishes, a reading
+ * comes in or the next batch is due.
+ */
+void HttpFanout::run() {
+  while (true) {
+    unsigned long long now = monotonicMicros();
+    unsigned long long wait = 1000000;
+    for (unsigned int i = 0; i < this->nServices; i++) {
+      if (!this->services[i].busy) {
+        unsigned long long due = this->startRequest(this->services[i], now);
+        if (due > 0 && due < wait) {
+          wait = due;
+        }
+      }
+    }
+
+    int nRunning;
+    curl_multi_perform(this->multi, &nRunning);
+
+    bool bFinished = false;
+    int nLeft;
+    CURLMsg* message;
+    while ((message = curl_multi_info_read(this->multi, &nLeft)) != NULL) {
+      if (message->msg == CURLMSG_DONE) {
+        this->finishRequest(message->easy_handle, message->data.result);
+        bFinished = true;
+      }
+    }
+    // a service that finished may have more readings: back to the top without sleeping
+    if (!bFinished) {
+      int nTimeout = (int)((wait + 999) / 1000);
+#if HTTP_HAS_WAKEUP
+      curl_multi_poll(this->multi, NULL, 0, nTimeout, NULL);
+#else
+      // nothing wakes the loop up: look at the queues every HTTP_IDLE_POLL ms,
+      // and sleep here when no transfer runs (curl_multi_wait() would return at once)
+      if (nTimeout > HTTP_IDLE_POLL) {
+        nTimeout = HTTP_IDLE_POLL;
+      }
+      if (nRunning > 0) {
+        curl_multi_wait(this->multi, NULL, 0, nTimeout, NULL);
+      } else {
+        usleep(nTimeout * 1000);
+      }
+#endif
+    }
+  }
+}
+
+/**
+ * Takes the service's waiting readings and, when a request is due, adds it to
+ * the multi handle: with a reading for a single service, with nBatch of them
+ * or the oldest nMaxLatency old for a batch one. Without a token the batch
+ * keeps filling, and the queue of a single service is coalesced.
+ *
+ * @return microseconds until the readings taken so far are due, 0 if nothing is pending
+ */
+unsigned long long HttpFanout::startRequest(Service& service, unsigned long long now) {
+  unsigned long long wait = this->waitToken(service, now);
+  if (wait > 0) {
+    if (service.sink->getPending() == 0 && service.nRecords == 0) {
+      return 0;
+    }
+    if (service.batch) {
+      // a bulk request carries every reading (a PIR going 1 then 0): they wait in the batch
+      while (service.nRecords < service.nBatch && service.sink->pop(service.records[service.nRecords])) {
+        service.nRecords++;
+      }
+    } else {
+      // saturated: whatever comes in meanwhile replaces the waiting reading of its station
+      service.sink->coalesce();
+    }
+    return wait;
+  }
+
+  char url[HTTP_URL_SIZE];
+  unsigned int nCount = 0;
+  while (nCount == 0) {
+    while (service.nRecords < service.nBatch && service.sink->pop(service.records[service.nRecords])) {
+      service.nRecords++;
+    }
+    if (service.nRecords == 0) {
+      return 0;
+    }
+    if (service.nRecords < service.nBatch) {
+      // it may have come in after now was read
+      unsigned long long receivedAt = service.records[0].receivedAt;
+      unsigned long long age = now > receivedAt ? now - receivedAt : 0;
+      if (age < service.maxLatency) {
+        return service.maxLatency - age;
+      }
+    }
+    if (service.batch) {
+      nCount = service.batch(service.records, service.nRecords, url, sizeof(url), service.body, sizeof(service.body));
+    } else {
+      nCount = service.url(service.records[0], url, sizeof(url)) ? 1 : 0;
+    }
+    if (nCount == 0) {
+      // the service does not take this one
+      service.sink->done(service.records[0], false);
+      this->removeRecords(service, 1);
+    }
+  }
+  service.nSending = nCount < service.nRecords ? nCount : service.nRecords;
+
+  service.responseLength = 0;
+  service.response[0] = '\0';
+  // the easy handle copies the URL; the body is read from service.body as it is sent
+  curl_easy_setopt(service.curl, CURLOPT_URL, url);
+  if (service.batch) {
+    printf("\n%s (%u readings)\n%s\n", url, service.nSending, service.body);
+    curl_easy_setopt(service.curl, CURLOPT_POSTFIELDS, service.body);
+  } else {
+    printf("\n%s\n", url);
+  }
+  curl_multi_add_handle(this->multi, service.curl);
+  service.busy = true;
+  if (service.rateInterval > 0) {
+    service.credit -= service.rateInterval;
+  }
+  return 0;
+}
+
+/**
+ * Refills the service's token bucket.
+ *
+ * @return microseconds until it has a token, 0 if it has one or no limit
+ */
+unsigned long long HttpFanout::waitToken(Service& service, unsigned long long now) {
+  if (service.rateInterval == 0) {
+    return 0;
+  }
+  if (now > service.refilledAt) {
+    unsigned long long full = service.rateInterval * service.rateBurst;
+    service.credit += now - service.refilledAt;
+    if (service.credit > full) {
+      service.credit = full;
+    }
+    service.refilledAt = now;
+  }
+  return service.credit >= service.rateInterval ? 0 : service.rateInterval - service.credit;
+}
+
+/**
+ * Takes a finished request off the multi handle, keeps its time and tells the
+ * service's sink how it went for each reading it carried. Passing them on may
+ * block (the database).
+ */
+void HttpFanout::finishRequest(CURL* curl, CURLcode result) {
+  Service* service = NULL;
+  curl_easy_getinfo(curl, CURLINFO_PRIVATE, (char**)&service);
+  curl_multi_remove_handle(this->multi, curl);
+
+  curl_off_t totalTime = 0;
+  long nConnects = 0;
+  curl_easy_getinfo(curl, CURLINFO_TOTAL_TIME_T, &totalTime);
+  curl_easy_getinfo(curl, CURLINFO_NUM_CONNECTS, &nConnects);
+  {
+    std::lock_guard<std::mutex> lock(this->latencyMutex);
+    HttpLatency& latency = service->latency;
+    latency.requests++;
+    latency.connects += nConnects;
+    latency.last = totalTime / 1000;
+    if (latency.last > latency.max) {
+      latency.max = latency.last;
+    }
+    service->totalTime += totalTime;
+    latency.average = service->totalTime / latency.requests / 1000;
+  }
+
+  bool bDelivered = false;
+  if (result != CURLE_OK) {
+    fprintf(stderr, "%s: %s\n", service->sink->getName(), curl_easy_strerror(result));
+  } else {
+    printf("%s\n", service->response);
+    bDelivered = !service->check || service->check(service->response);
+  }
+  service->busy = false;
+  for (unsigned int i = 0; i < service->nSending; i++) {
+    service->sink->done(service->records[i], bDelivered);
+  }
+  this->removeRecords(*service, service->nSending);
+  service->nSending = 0;
+}
+
+/**
+ * Drops the first readings of a service's batch, done with
+ */
+void HttpFanout::removeRecords(Service& service, unsigned int nCount) {
+  for (unsigned int i = nCount; i < service.nRecords; i++) {
+    service.records[i - nCount] = service.records[i];
+  }
+  service.nRecords -= nCount;
+}
@@ -0,0 +1,139 @@
+/*
+  HttpFanout - posts the readings to the web services from one curl multi loop.
+
+  Each service is a SensorSink without a thread of its own (see
+  SensorSink::createQueue), with its own bounded queue and full-queue policy as
+  before. A single thread drives a curl multi handle: whenever a service has no
+  request in flight and a reading waiting, its next request is started, so the
+  services are posted to concurrently and a slow one only delays itself.
+
+  Every service keeps one easy handle, and the multi handle keeps the
+  connections: a request to the same host reuses the open (TLS) connection
+  instead of a new handshake, and TCP keep-alive keeps it open between readings
+  where the server allows. Requests give up after HTTP_CONNECT_TIMEOUT to
+  connect and HTTP_TIMEOUT in all; the time each took is kept per service.
+
+  A service with a bulk endpoint can take its readings in batches instead
+  (addBatchService): they are collected until there are nBatch of them or the
+  oldest was received nMaxLatency ago, then POSTed together, the builder
+  deciding how many of them fit one request (e.g. only readings of the same
+  kind). Every reading of the batch is then delivered or failed together.
+
+  A service that refuses requests too close together gets a token bucket
+  (setRateLimit): a request takes a token, one comes back every nInterval ms,
+  up to nBurst. Without a token nothing is sent. A batch service keeps
+  collecting its batch meanwhile, up to nBatch, and the next request carries
+  all of it; the queue of any other service is coalesced instead (see
+  SensorSink::coalesce) so that, when the token comes, the newest reading of
+  each station goes rather than the oldest.
+
+  A reading for an idle service wakes the loop up at once with libcurl 7.68 or
+  newer (curl_multi_wakeup); with an older one the loop looks at the queues
+  every HTTP_IDLE_POLL ms instead.
+
+  curl_global_init() must have been called before the HttpFanout is created.
+*/
+#ifndef _HttpFanout_h
+#define _HttpFanout_h
+
+#include <mutex>
+#include <functional>
+#include <curl/curl.h>
+#include "SensorPipeline.h"
+
+// services one fan-out posts to
+#define HTTP_MAX_SERVICES 4
+
+// milliseconds
+#define HTTP_CONNECT_TIMEOUT 5000
+#define HTTP_TIMEOUT 10000
+// longest a reading waits to be noticed, before libcurl 7.68
+#define HTTP_IDLE_POLL 100
+
+#define HTTP_URL_SIZE 512
+// POST body of a batch
+#define HTTP_BODY_SIZE 4096
+// readings in one batch
+#define HTTP_MAX_BATCH 32
+// what is kept of a response, for the service to check it
+#define HTTP_RESPONSE_SIZE 256
+
+/**
+ * Requests a service finished and how long they took, in milliseconds
+ */
+struct HttpLatency {
+    unsigned long requests;
+    unsigned long connects;     // new connections; fewer than requests when they are reused
+    unsigned long last;
+    unsigned long max;
+    unsigned long average;
+};
+
+
+class HttpFanout {
+
+  public:
+    // writes the URL to post a reading to; returns false if the service does not take it
+    typedef std::function<bool(const SensorRecord& record, char* url, size_t size)> UrlBuilder;
+    // writes the URL and the JSON body to POST the readings at the front of records;
+    // returns how many it took, 0 if the service does not take the first one
+    typedef std::function<unsigned int(const SensorRecord* records, unsigned int nRecords,
+                                       char* url, size_t urlSize, char* body, size_t bodySize)> BatchBuilder;
+    // whether the service accepted the reading(s), from its response
+    typedef std::function<bool(const char* response)> ResponseCheck;
+
+    HttpFanout();
+
+    SensorSink* addService(const char* sName, UrlBuilder url, ResponseCheck check,
+                           unsigned int nCapacity, int nPolicy);
+    SensorSink* addBatchService(const char* sName, BatchBuilder batch, ResponseCheck check,
+                                unsigned int nBatch, unsigned int nMaxLatency,
+                                unsigned int nCapacity, int nPolicy);
+    bool setRateLimit(SensorSink* sink, unsigned int nInterval, unsigned int nBurst);
+    bool start();
+    bool getLatency(SensorSink* sink, HttpLatency& latency);
+
+  private:
+    struct Service {
+      SensorSink* sink;
+      UrlBuilder url;
+      BatchBuilder batch;       // set for a batch service instead of url
+      ResponseCheck check;
+      unsigned int nBatch;      // 1 without batches
+      unsigned long long maxLatency;    // microseconds
+      // token bucket, in microseconds: a token is worth rateInterval, credit is at most rateInterval * rateBurst
+      unsigned long long rateInterval;  // 0 without a limit
+      unsigned int rateBurst;
+      unsigned long long credit;
+      unsigned long long refilledAt;
+      CURL* curl;
+      bool busy;
+      // readings taken from the sink: the first nSending are being posted
+      SensorRecord records[HTTP_MAX_BATCH];
+      unsigned int nRecords;
+      unsigned int nSending;
+      char body[HTTP_BODY_SIZE];
+      char response[HTTP_RESPONSE_SIZE];
+      size_t responseLength;
+      HttpLatency latency;
+      unsigned long long totalTime;
+    };
+
+    static size_t receive(char* ptr, size_t size, size_t nmemb, void* userdata);
+
+    void run();
+    Service* newService(const char* sName, ResponseCheck check, unsigned int nCapacity, int nPolicy);
+    unsigned long long startRequest(Service& service, unsigned long long now);
+    unsigned long long waitToken(Service& service, unsigned long long now);
+    void finishRequest(CURL* curl, CURLcode result);
+    void removeRecords(Service& service, unsigned int nCount);
+
+    CURLM* multi;
+    struct curl_slist* jsonHeaders;
+    Service services[HTTP_MAX_SERVICES];
+    unsigned int nServices;
+    // guards the latencies, read by other threads
+    std::mutex latencyMutex;
+};
+
+#endif
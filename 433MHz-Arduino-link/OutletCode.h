@@ -0,0 +1,126 @@
+/*
+  OutletCode - the tri-state code word that switches one outlet on or off.
+
+  A Code Word consists of 9 address bits, 3 data bits and one sync bit.
+  A Code Bit can have 4 different states: "F" (floating), "0" (low), "1" (high), "S" (synchronous bit)
+
+  Type A (10 pole DIP switches):
+  +-----------------------------------------+-------------------------------+----------------------+
+  | 5 bits address (DIP switches 1..5)      | 5 bits address (switch number)| 2 data bits (on|off) |
+  | "1" (on) = 0, "0" (off) = F             | 1=0FFFF 2=F0FFF ... 5=FFFF0   | on=0F off=F0         |
+  +-----------------------------------------+-------------------------------+----------------------+
+
+  Type B (two rotary/sliding switches), only the first 8 address bits and the last 2 data bits are used:
+  +-------------------------------+--------------------------------+-----------------------+----------------------+
+  | 4 bits address (switch group) | 4 bits address (switch number) | 2 bits address unused | 2 data bits (on|off) |
+  | 1=0FFF 2=F0FF 3=FF0F 4=FFF0   | 1=0FFF 2=F0FF 3=FF0F 4=FFF0    | FF                    | on=FF off=F0         |
+  +-------------------------------+--------------------------------+-----------------------+----------------------+
+
+  Type C (Intertechno):
+  +-------------------------------+---------------------------------------+-------+----------------------+
+  | 4 bits family (a..p)          | 4 bits (device-1)+(group-1)*4         | 0F    | 2 data bits (on|off) |
+  | a=0000 b=F000 c=0F00 ...      | lowest bit first, 1 = F, 0 = 0        |       | on=FF off=F0         |
+  +-------------------------------+---------------------------------------+-------+----------------------+
+
+  The code words are built by constexpr functions: for a fixed set of outlets
+  they are computed at compile time, e.g.
+
+    constexpr OutletCode lampOn = OutletCode::typeC('a', 1, 2, true);
+
+  and a list of them can be switched in one burst with RCSwitch::switchBatch().
+  Invalid arguments give a code word for which isValid() is false.
+*/
+#ifndef _OutletCode_h
+#define _OutletCode_h
+
+struct OutletCode {
+  char sCodeWord[13];
+
+  /**
+   * Type A with 10 pole DIP switches
+   *
+   * @param sGroup        Code of the switch group (refers to DIP switches 1..5 where "1" = on and "0" = off, if all DIP switches are on it's "11111")
+   * @param nChannelCode  Number of the switch itself (1..5)
+   * @param bStatus       Wether to switch on (true) or off (false)
+   */
+  static constexpr OutletCode typeA(const char* sGroup, int nChannelCode, bool bStatus) {
+    OutletCode code = {};
+    if (sGroup == nullptr || nChannelCode < 1 || nChannelCode > 5) {
+      return code;
+    }
+    for (int i = 0; i < 5; i++) {
+      if (sGroup[i] != '0' && sGroup[i] != '1') {
+        return OutletCode {};
+      }
+      code.sCodeWord[i] = sGroup[i] == '1' ? '0' : 'F';
+    }
+    for (int i = 0; i < 5; i++) {
+      code.sCodeWord[5 + i] = i == nChannelCode - 1 ? '0' : 'F';
+    }
+    code.sCodeWord[10] = bStatus ? '0' : 'F';
+    code.sCodeWord[11] = bStatus ? 'F' : '0';
+    return code;
+  }
+
+  /**
+   * Type B with two rotary/sliding switches
+   *
+   * @param nAddressCode  Number of the switch group (1..4)
+   * @param nChannelCode  Number of the switch itself (1..4)
+   * @param bStatus       Wether to switch on (true) or off (false)
+   */
+  static constexpr OutletCode typeB(int nAddressCode, int nChannelCode, bool bStatus) {
+    OutletCode code = {};
+    if (nAddressCode < 1 || nAddressCode > 4 || nChannelCode < 1 || nChannelCode > 4) {
+      return code;
+    }
+    for (int i = 0; i < 4; i++) {
+      code.sCodeWord[i] = i == nAddressCode - 1 ? '0' : 'F';
+      code.sCodeWord[4 + i] = i == nChannelCode - 1 ? '0' : 'F';
+    }
+    code.sCodeWord[8] = 'F';
+    code.sCodeWord[9] = 'F';
+    code.sCodeWord[10] = 'F';
+    code.sCodeWord[11] = bStatus ? 'F' : '0';
+    return code;
+  }
+
+  /**
+   * Type C Intertechno
+   *
+   * @param sFamily  Familycode (a..p)
+   * @param nGroup   Number of group (1..4)
+   * @param nDevice  Number of device (1..4)
+   * @param bStatus  Wether to switch on (true) or off (false)
+   */
+  static constexpr OutletCode typeC(char sFamily, int nGroup, int nDevice, bool bStatus) {
+    OutletCode code = {};
+    if (sFamily < 'a' || sFamily > 'p' || nGroup < 1 || nGroup > 4 || nDevice < 1 || nDevice > 4) {
+      return code;
+    }
+    int nFamily = sFamily - 'a';
+    int nDeviceGroup = (nDevice - 1) + (nGroup - 1) * 4;
+    for (int i = 0; i < 4; i++) {
+      code.sCodeWord[i] = (nFamily >> i) & 1 ? 'F' : '0';
+      code.sCodeWord[4 + i] = (nDeviceGroup >> i) & 1 ? 'F' : '0';
+    }
+    code.sCodeWord[8] = '0';
+    code.sCodeWord[9] = 'F';
+    code.sCodeWord[10] = 'F';
+    code.sCodeWord[11] = bStatus ? 'F' : '0';
+    return code;
+  }
+
+  constexpr bool isValid() const {
+    return this->sCodeWord[0] != '\0';
+  }
+
+  /**
+   * The code word for RCSwitch::sendTriState(), NULL if invalid
+   */
+  constexpr const char* get() const {
+    return this->isValid() ? this->sCodeWord : nullptr;
+  }
+};
+
+#endif
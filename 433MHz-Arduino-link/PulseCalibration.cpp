@@ -0,0 +1,125 @@
+/*
+  PulseCalibration - learned pulse widths of one transmitting station, see PulseCalibration.h
+*/
+
+#include "PulseCalibration.h"
+#include <string.h>
+
+// samples per histogram before the old ones are halved away
+#define CALIBRATION_HISTORY 4096
+// extra room around the learned range, in histogram bins (1/8 pulse length)
+#define CALIBRATION_MARGIN 4
+
+PulseCalibration::PulseCalibration() {
+  memset(this->histogram, 0, sizeof(this->histogram));
+  for (int n = 0; n < TIMINGS; n++) {
+    this->total[n] = 0;
+    this->low[n] = 0;
+    this->high[n] = CALIBRATION_BINS - 1;
+  }
+  this->nFrames = 0;
+}
+
+/**
+ * Learns from one accepted frame.
+ *
+ * @param timings   2 * nBits timings, first/second of each bit
+ * @param nBits     Number of bits
+ * @param code      The bits the frame was decoded to, first one most significant
+ * @param delay     Pulse length of the frame in microseconds
+ */
+void PulseCalibration::add(const unsigned int* timings, unsigned int nBits, unsigned long long code, unsigned int delay) {
+  if (delay == 0) {
+    return;
+  }
+  for (unsigned int i = 0; i < nBits; i++) {
+    bool one = (code >> (nBits - 1 - i)) & 1;
+    this->addTiming(one ? ONE_FIRST : ZERO_FIRST, timings[2 * i], delay);
+    this->addTiming(one ? ONE_SECOND : ZERO_SECOND, timings[2 * i + 1], delay);
+  }
+  this->nFrames++;
+  this->learn();
+}
+
+void PulseCalibration::addTiming(int nTiming, unsigned int timing, unsigned int delay) {
+  unsigned int bin = ((unsigned long long)timing * CALIBRATION_STEPS + delay / 2) / delay;
+  if (bin >= CALIBRATION_BINS) {
+    bin = CALIBRATION_BINS - 1;
+  }
+  this->histogram[nTiming][bin]++;
+  this->total[nTiming]++;
+
+  if (this->total[nTiming] >= CALIBRATION_HISTORY) {
+    this->total[nTiming] = 0;
+    for (unsigned int b = 0; b < CALIBRATION_BINS; b++) {
+      this->histogram[nTiming][b] /= 2;
+      this->total[nTiming] += this->histogram[nTiming][b];
+    }
+  }
+}
+
+/**
+ * Recomputes the bounds: the 0.5% and 99.5% points of each histogram, widened by the margin.
+ */
+void PulseCalibration::learn() {
+  for (int n = 0; n < TIMINGS; n++) {
+    if (this->total[n] == 0) {
+      continue;
+    }
+    unsigned int lowCount = this->total[n] / 200;
+    unsigned int highCount = this->total[n] - lowCount;
+    unsigned int count = 0;
+    int lowBin = -1, highBin = CALIBRATION_BINS - 1;
+    for (int b = 0; b < CALIBRATION_BINS; b++) {
+      count += this->histogram[n][b];
+      if (lowBin < 0 && count > lowCount) {
+        lowBin = b;
+      }
+      if (count >= highCount) {
+        highBin = b;
+        break;
+      }
+    }
+    this->low[n] = lowBin > CALIBRATION_MARGIN ? lowBin - CALIBRATION_MARGIN : 0;
+    this->high[n] = highBin + CALIBRATION_MARGIN < CALIBRATION_BINS ? highBin + CALIBRATION_MARGIN : CALIBRATION_BINS - 1;
+  }
+}
+
+bool PulseCalibration::isReady() {
+  return this->nFrames >= CALIBRATION_MIN_FRAMES;
+}
+
+/**
+ * Window covering the learned bins: bin b holds timings rounding to b/CALIBRATION_STEPS pulses.
+ */
+PulseWindow PulseCalibration::window(int nTiming, unsigned int delay) {
+  unsigned int start = this->low[nTiming] > 0 ? ((2 * this->low[nTiming] - 1) * delay) / (2 * CALIBRATION_STEPS) : 0;
+  unsigned int end = ((2 * this->high[nTiming] + 1) * delay) / (2 * CALIBRATION_STEPS);
+  PulseWindow window;
+  window.base = start;
+  window.width = end - start;
+  return window;
+}
+
+/**
+ * Learned windows at the pulse length of the frame being decoded.
+ */
+PulseWindows PulseCalibration::getWindows(unsigned int delay) {
+  PulseWindows windows;
+  windows.zeroFirst = this->window(ZERO_FIRST, delay);
+  windows.zeroSecond = this->window(ZERO_SECOND, delay);
+  windows.oneFirst = this->window(ONE_FIRST, delay);
+  windows.oneSecond = this->window(ONE_SECOND, delay);
+  return windows;
+}
+
+RCSwitchCalibration PulseCalibration::getCalibration() {
+  RCSwitchCalibration calibration;
+  PulseRange* ranges[TIMINGS] = { &calibration.zeroFirst, &calibration.zeroSecond, &calibration.oneFirst, &calibration.oneSecond };
+  calibration.frames = this->nFrames;
+  for (int n = 0; n < TIMINGS; n++) {
+    ranges[n]->low = this->low[n] * 100 / CALIBRATION_STEPS;
+    ranges[n]->high = this->high[n] * 100 / CALIBRATION_STEPS;
+  }
+  return calibration;
+}
@@ -0,0 +1,74 @@
+/*
+  PulseCalibration - learned pulse widths of one transmitting station.
+
+  Every frame accepted from a station adds its timings to four histograms (first
+  and second timing of "0" and "1" bits), measured relative to the pulse length
+  of that frame's sync in 1/32 pulse steps. Once enough frames were seen, the
+  acceptance window for each timing is the range that holds 99% of what the
+  station really sends, plus a small margin, instead of the fixed
+  +/- nReceiveTolerance. That keeps a fixed high/low asymmetry of a transmitter
+  (a slow receiver output, a sagging battery) inside the window while noise that
+  only fits the wide default window is rejected.
+
+  Old samples are halved away as new ones arrive, so the windows follow a
+  station whose clock drifts with temperature.
+*/
+#ifndef _PulseCalibration_h
+#define _PulseCalibration_h
+
+#include "PulseClassifier.h"
+
+// histogram resolution: bins per pulse length, and pulse lengths covered
+#define CALIBRATION_STEPS 32
+#define CALIBRATION_PULSES 5
+#define CALIBRATION_BINS (CALIBRATION_STEPS * CALIBRATION_PULSES)
+
+// frames needed before the learned windows are used
+#define CALIBRATION_MIN_FRAMES 8
+
+/**
+ * Range of accepted timings, in percent of the pulse length.
+ */
+struct PulseRange {
+    unsigned int low;
+    unsigned int high;
+};
+
+/**
+ * What was learned about one station.
+ */
+struct RCSwitchCalibration {
+    unsigned int frames;        // frames the histograms are built from (before aging)
+    PulseRange zeroFirst;
+    PulseRange zeroSecond;
+    PulseRange oneFirst;
+    PulseRange oneSecond;
+};
+
+
+class PulseCalibration {
+
+  public:
+    PulseCalibration();
+
+    void add(const unsigned int* timings, unsigned int nBits, unsigned long long code, unsigned int delay);
+    bool isReady();
+    PulseWindows getWindows(unsigned int delay);
+    RCSwitchCalibration getCalibration();
+
+  private:
+    enum { ZERO_FIRST, ZERO_SECOND, ONE_FIRST, ONE_SECOND, TIMINGS };
+
+    void addTiming(int nTiming, unsigned int timing, unsigned int delay);
+    void learn();
+    PulseWindow window(int nTiming, unsigned int delay);
+
+    unsigned short histogram[TIMINGS][CALIBRATION_BINS];
+    unsigned int total[TIMINGS];
+    unsigned int nFrames;
+    // learned bounds, in histogram bins (inclusive)
+    unsigned short low[TIMINGS];
+    unsigned short high[TIMINGS];
+};
+
+#endif
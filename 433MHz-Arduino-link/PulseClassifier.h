@@ -0,0 +1,261 @@
+/*
+  PulseClassifier - turns the pulse pairs of one frame into its bits.
+
+  Each bit is a (first, second) pair of timings that must match the "0" or the
+  "1" pulse shape of the protocol: a timing matches n pulse lengths if it is
+  strictly inside delay*n +/- tolerance. All the math is integer; a window test
+  is a single unsigned compare ((timing - low - 1) < width wraps around for
+  timings under the window), so whole groups of pairs can be tested with SIMD:
+  NEON on the Pi 2/3, SSE2 or AVX2 on x86. Any other target (the Pi Zero's
+  ARMv6 has no NEON) uses the same test one pair at a time.
+
+  The functions are inline so a caller passing constant pulse shapes gets
+  them folded into the window bounds.
+*/
+#ifndef _PulseClassifier_h
+#define _PulseClassifier_h
+
+#include <stdint.h>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+    #include <immintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    #include <arm_neon.h>
+#endif
+
+/**
+ * Acceptance window for a timing of nPulses pulse lengths, as (timing - base) < width.
+ */
+struct PulseWindow {
+    uint32_t base;
+    uint32_t width;
+};
+
+inline PulseWindow pulseWindow(uint32_t delay, uint32_t delayTolerance, uint32_t nPulses) {
+  PulseWindow window;
+  // timing > delay*n - tolerance && timing < delay*n + tolerance
+  window.base = delay * nPulses - delayTolerance + 1;
+  window.width = delayTolerance > 0 ? 2 * delayTolerance - 1 : 0;
+  return window;
+}
+
+/**
+ * The four windows a bit is checked against.
+ */
+struct PulseWindows {
+    PulseWindow zeroFirst;
+    PulseWindow zeroSecond;
+    PulseWindow oneFirst;
+    PulseWindow oneSecond;
+};
+
+/**
+ * The part of two windows that is in both.
+ */
+inline PulseWindow intersectWindow(PulseWindow a, PulseWindow b) {
+  uint32_t low = a.base > b.base ? a.base : b.base;
+  uint32_t highA = a.base + a.width, highB = b.base + b.width;
+  uint32_t high = highA < highB ? highA : highB;
+  PulseWindow window;
+  window.base = low;
+  window.width = high > low ? high - low : 0;
+  return window;
+}
+
+/**
+ * Pulse tolerance for a given pulse length, integer version of delay * nPercent * 0.01
+ */
+inline uint32_t pulseTolerance(uint32_t delay, uint32_t nPercent) {
+  return delay * nPercent / 100;
+}
+
+// reverses the order of the low 4 bits: SIMD lanes come out oldest bit first, codes are MSB first
+static const uint8_t pulseReverse4[16] = { 0, 8, 4, 12, 2, 10, 6, 14, 1, 9, 5, 13, 3, 11, 7, 15 };
+
+/**
+ * Windows of a protocol's pulse shapes at a given pulse length and tolerance.
+ *
+ * @param delay         Pulse length in microseconds
+ * @param nPercent      Tolerance in percent of the pulse length
+ * @param zeroFirst     "0" bit: pulse lengths of the first timing
+ * @param zeroSecond    "0" bit: pulse lengths of the second timing
+ * @param oneFirst      "1" bit: pulse lengths of the first timing
+ * @param oneSecond     "1" bit: pulse lengths of the second timing
+ */
+inline PulseWindows pulseWindows(uint32_t delay, uint32_t nPercent,
+                                 uint32_t zeroFirst, uint32_t zeroSecond, uint32_t oneFirst, uint32_t oneSecond) {
+  uint32_t delayTolerance = pulseTolerance(delay, nPercent);
+  PulseWindows windows;
+  windows.zeroFirst = pulseWindow(delay, delayTolerance, zeroFirst);
+  windows.zeroSecond = pulseWindow(delay, delayTolerance, zeroSecond);
+  windows.oneFirst = pulseWindow(delay, delayTolerance, oneFirst);
+  windows.oneSecond = pulseWindow(delay, delayTolerance, oneSecond);
+  return windows;
+}
+
+/**
+ * Classifies nBits pulse pairs starting at timings[0].
+ *
+ * A pair matching the "0" windows gives a 0 (it wins if both match), one matching
+ * the "1" windows gives a 1, anything else fails the whole frame.
+ *
+ * @param timings       2 * nBits timings, first/second of each bit
+ * @param nBits         Number of bits, at most 64
+ * @param windows       What a "0" and a "1" look like
+ * @param code          Receives the bits, first one most significant
+ *
+ * @return false if a pair matched neither shape
+ */
+inline bool classifyPulses(const unsigned int* timings, unsigned int nBits, const PulseWindows& windows,
+                           unsigned long long* code) {
+  const PulseWindow z0 = windows.zeroFirst;
+  const PulseWindow z1 = windows.zeroSecond;
+  const PulseWindow o0 = windows.oneFirst;
+  const PulseWindow o1 = windows.oneSecond;
+
+  unsigned long long result = 0;
+  unsigned int i = 0;
+
+#if defined(__AVX2__)
+  {
+    // unsigned compares through the signed one: flip the sign bit on both sides
+    const __m256i bias = _mm256_set1_epi32((int)0x80000000);
+    const __m256i z0b = _mm256_set1_epi32((int)z0.base), z0w = _mm256_set1_epi32((int)(z0.width ^ 0x80000000));
+    const __m256i z1b = _mm256_set1_epi32((int)z1.base), z1w = _mm256_set1_epi32((int)(z1.width ^ 0x80000000));
+    const __m256i o0b = _mm256_set1_epi32((int)o0.base), o0w = _mm256_set1_epi32((int)(o0.width ^ 0x80000000));
+    const __m256i o1b = _mm256_set1_epi32((int)o1.base), o1w = _mm256_set1_epi32((int)(o1.width ^ 0x80000000));
+
+    for (; i + 8 <= nBits; i += 8) {
+      __m256i a = _mm256_loadu_si256((const __m256i*)(timings + 2 * i));
+      __m256i b = _mm256_loadu_si256((const __m256i*)(timings + 2 * i + 8));
+      // deinterleave: shuffle within 128 bit lanes, then put the 64 bit halves back in order
+      __m256i first = _mm256_castps_si256(_mm256_shuffle_ps(_mm256_castsi256_ps(a), _mm256_castsi256_ps(b), _MM_SHUFFLE(2, 0, 2, 0)));
+      __m256i second = _mm256_castps_si256(_mm256_shuffle_ps(_mm256_castsi256_ps(a), _mm256_castsi256_ps(b), _MM_SHUFFLE(3, 1, 3, 1)));
+      first = _mm256_permute4x64_epi64(first, _MM_SHUFFLE(3, 1, 2, 0));
+      second = _mm256_permute4x64_epi64(second, _MM_SHUFFLE(3, 1, 2, 0));
+
+      __m256i zero = _mm256_and_si256(
+          _mm256_cmpgt_epi32(z0w, _mm256_xor_si256(_mm256_sub_epi32(first, z0b), bias)),
+          _mm256_cmpgt_epi32(z1w, _mm256_xor_si256(_mm256_sub_epi32(second, z1b), bias)));
+      __m256i one = _mm256_and_si256(
+          _mm256_cmpgt_epi32(o0w, _mm256_xor_si256(_mm256_sub_epi32(first, o0b), bias)),
+          _mm256_cmpgt_epi32(o1w, _mm256_xor_si256(_mm256_sub_epi32(second, o1b), bias)));
+
+      unsigned int zeroMask = _mm256_movemask_ps(_mm256_castsi256_ps(zero));
+      unsigned int oneMask = _mm256_movemask_ps(_mm256_castsi256_ps(one));
+      if ((zeroMask | oneMask) != 0xFF) {
+        return false;
+      }
+      oneMask &= ~zeroMask;
+      result = (result << 8) | (pulseReverse4[oneMask & 0xF] << 4) | pulseReverse4[oneMask >> 4];
+    }
+  }
+#endif
+
+#if defined(__SSE2__)
+  {
+    const __m128i bias = _mm_set1_epi32((int)0x80000000);
+    const __m128i z0b = _mm_set1_epi32((int)z0.base), z0w = _mm_set1_epi32((int)(z0.width ^ 0x80000000));
+    const __m128i z1b = _mm_set1_epi32((int)z1.base), z1w = _mm_set1_epi32((int)(z1.width ^ 0x80000000));
+    const __m128i o0b = _mm_set1_epi32((int)o0.base), o0w = _mm_set1_epi32((int)(o0.width ^ 0x80000000));
+    const __m128i o1b = _mm_set1_epi32((int)o1.base), o1w = _mm_set1_epi32((int)(o1.width ^ 0x80000000));
+
+    for (; i + 4 <= nBits; i += 4) {
+      __m128 a = _mm_castsi128_ps(_mm_loadu_si128((const __m128i*)(timings + 2 * i)));
+      __m128 b = _mm_castsi128_ps(_mm_loadu_si128((const __m128i*)(timings + 2 * i + 4)));
+      __m128i first = _mm_castps_si128(_mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+      __m128i second = _mm_castps_si128(_mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+
+      __m128i zero = _mm_and_si128(
+          _mm_cmplt_epi32(_mm_xor_si128(_mm_sub_epi32(first, z0b), bias), z0w),
+          _mm_cmplt_epi32(_mm_xor_si128(_mm_sub_epi32(second, z1b), bias), z1w));
+      __m128i one = _mm_and_si128(
+          _mm_cmplt_epi32(_mm_xor_si128(_mm_sub_epi32(first, o0b), bias), o0w),
+          _mm_cmplt_epi32(_mm_xor_si128(_mm_sub_epi32(second, o1b), bias), o1w));
+
+      unsigned int zeroMask = _mm_movemask_ps(_mm_castsi128_ps(zero));
+      unsigned int oneMask = _mm_movemask_ps(_mm_castsi128_ps(one));
+      if ((zeroMask | oneMask) != 0xF) {
+        return false;
+      }
+      result = (result << 4) | pulseReverse4[oneMask & ~zeroMask];
+    }
+  }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+  {
+    const uint32x4_t z0b = vdupq_n_u32(z0.base), z0w = vdupq_n_u32(z0.width);
+    const uint32x4_t z1b = vdupq_n_u32(z1.base), z1w = vdupq_n_u32(z1.width);
+    const uint32x4_t o0b = vdupq_n_u32(o0.base), o0w = vdupq_n_u32(o0.width);
+    const uint32x4_t o1b = vdupq_n_u32(o1.base), o1w = vdupq_n_u32(o1.width);
+    // lane i -> bit (3 - i), so the sum of the lanes is already MSB first
+    static const uint32_t laneBitsData[4] = { 8, 4, 2, 1 };
+    const uint32x4_t laneBits = vld1q_u32(laneBitsData);
+
+    for (; i + 4 <= nBits; i += 4) {
+      // vld2 deinterleaves the pairs for us
+      uint32x4x2_t pairs = vld2q_u32((const uint32_t*)(timings + 2 * i));
+      uint32x4_t zero = vandq_u32(vcltq_u32(vsubq_u32(pairs.val[0], z0b), z0w),
+                                  vcltq_u32(vsubq_u32(pairs.val[1], z1b), z1w));
+      uint32x4_t one = vandq_u32(vcltq_u32(vsubq_u32(pairs.val[0], o0b), o0w),
+                                 vcltq_u32(vsubq_u32(pairs.val[1], o1b), o1w));
+
+      uint32x4_t valid = vandq_u32(vorrq_u32(zero, one), laneBits);
+      uint32x4_t ones = vandq_u32(vbicq_u32(one, zero), laneBits);
+      uint32x2_t sums = vpadd_u32(vadd_u32(vget_low_u32(valid), vget_high_u32(valid)),
+                                  vadd_u32(vget_low_u32(ones), vget_high_u32(ones)));
+      if (vget_lane_u32(sums, 0) != 0xF) {
+        return false;
+      }
+      result = (result << 4) | vget_lane_u32(sums, 1);
+    }
+  }
+#endif
+
+  for (; i < nBits; i++) {
+    uint32_t first = timings[2 * i];
+    uint32_t second = timings[2 * i + 1];
+    bool zero = first - z0.base < z0.width && second - z1.base < z1.width;
+    bool one = first - o0.base < o0.width && second - o1.base < o1.width;
+    if (!zero && !one) {
+      return false;
+    }
+    result = (result << 1) | (one && !zero);
+  }
+
+  *code = result;
+  return true;
+}
+
+/**
+ * Same as above with the windows of a protocol's pulse shapes, see pulseWindows().
+ */
+inline bool classifyPulses(const unsigned int* timings, unsigned int nBits, uint32_t delay, uint32_t nPercent,
+                           uint32_t zeroFirst, uint32_t zeroSecond, uint32_t oneFirst, uint32_t oneSecond,
+                           unsigned long long* code) {
+  return classifyPulses(timings, nBits, pulseWindows(delay, nPercent, zeroFirst, zeroSecond, oneFirst, oneSecond), code);
+}
+
+/**
+ * Classifies every pair on its own, for a frame classifyPulses() rejected:
+ * the bits that did match a shape can still be voted on (see RCSwitchDecoder).
+ * Only runs on damaged frames, so there is no SIMD version.
+ *
+ * @param ones      Receives a 1 for every pair that matched the "1" shape only, first bit most significant
+ * @param valid     Receives a 1 for every pair that matched either shape
+ */
+inline void classifyPulseBits(const unsigned int* timings, unsigned int nBits, const PulseWindows& windows,
+                              unsigned long long* ones, unsigned long long* valid) {
+  unsigned long long oneBits = 0, validBits = 0;
+  for (unsigned int i = 0; i < nBits; i++) {
+    uint32_t first = timings[2 * i];
+    uint32_t second = timings[2 * i + 1];
+    bool zero = first - windows.zeroFirst.base < windows.zeroFirst.width && second - windows.zeroSecond.base < windows.zeroSecond.width;
+    bool one = first - windows.oneFirst.base < windows.oneFirst.width && second - windows.oneSecond.base < windows.oneSecond.width;
+    oneBits = (oneBits << 1) | (one && !zero);
+    validBits = (validBits << 1) | (one || zero);
+  }
+  *ones = oneBits;
+  *valid = validBits;
+}
+
+#endif
@@ -0,0 +1,166 @@
+/*
+  PulseTrain - one frame as the level durations the transmitter has to produce, see PulseTrain.h
+*/
+
+#include "PulseTrain.h"
+
+PulseTrain::PulseTrain() {
+  this->nFirstLevel = 1;
+  // a 32 bit frame: 2 levels per bit plus the sync
+  this->durations.reserve(2 * 32 + 2);
+}
+
+void PulseTrain::clear() {
+  this->durations.clear();
+  this->nFirstLevel = 1;
+}
+
+/**
+ * Appends nDuration microseconds of level nLevel (0 or 1), merged into the last
+ * level if it is the same.
+ */
+void PulseTrain::addLevel(int nLevel, unsigned int nDuration) {
+  if (nDuration == 0) {
+    return;
+  }
+  if (this->durations.empty()) {
+    this->nFirstLevel = nLevel;
+  } else if (((this->nFirstLevel + this->durations.size() - 1) & 1) == (unsigned int)nLevel) {
+    this->durations.back() += nDuration;
+    return;
+  }
+  this->durations.push_back(nDuration);
+}
+
+/**
+ * Appends a high of nHighPulses then a low of nLowPulses pulse lengths.
+ */
+void PulseTrain::addPulses(unsigned int nHighPulses, unsigned int nLowPulses, unsigned int nPulseLength) {
+  this->addLevel(1, nHighPulses * nPulseLength);
+  this->addLevel(0, nLowPulses * nPulseLength);
+}
+
+/**
+ * Appends one waveform element of a protocol; an inverted protocol sends the low part first.
+ */
+void PulseTrain::addPulses(RCSwitchPulses pulses, bool bInverted, unsigned int nPulseLength) {
+  if (bInverted) {
+    this->addLevel(0, pulses.high * nPulseLength);
+    this->addLevel(1, pulses.low * nPulseLength);
+  } else {
+    this->addPulses(pulses.high, pulses.low, nPulseLength);
+  }
+}
+
+/**
+ * Compiles the nLength low bits of code, most significant first, then the sync.
+ *
+ *                       _              ___                 _
+ * Waveform Protocol 1: | |___ for 0,  |   |_ for 1, sync  | |_______________________________
+ *                       _              __                  _
+ * Waveform Protocol 2: | |__ for 0,   |  |_ for 1,  sync  | |__________
+ *
+ * @return false if nLength is more than the 64 bits of code
+ */
+bool PulseTrain::compile(unsigned long long code, unsigned int nLength, const RCSwitchProtocol& protocol, unsigned int nPulseLength) {
+  this->clear();
+  if (nLength > 64) {
+    return false;
+  }
+  for (unsigned int i = nLength; i > 0; i--) {
+    this->addPulses((code >> (i - 1)) & 1 ? protocol.one : protocol.zero, protocol.inverted, nPulseLength);
+  }
+  this->addPulses(protocol.sync, protocol.inverted, nPulseLength);
+  return true;
+}
+
+/**
+ * Compiles a code word of '0' and '1' characters, then the sync.
+ * Other characters are skipped, like RCSwitch always did.
+ */
+bool PulseTrain::compile(const char* sCodeWord, const RCSwitchProtocol& protocol, unsigned int nPulseLength) {
+  this->clear();
+  if (sCodeWord == NULL) {
+    return false;
+  }
+  for (const char* c = sCodeWord; *c != '\0'; c++) {
+    if (*c == '0') {
+      this->addPulses(protocol.zero, protocol.inverted, nPulseLength);
+    } else if (*c == '1') {
+      this->addPulses(protocol.one, protocol.inverted, nPulseLength);
+    }
+  }
+  this->addPulses(protocol.sync, protocol.inverted, nPulseLength);
+  return true;
+}
+
+/**
+ * Compiles a tri-state code word (see OutletCode.h), then the sync of the protocol.
+ *                  _     _                ___   ___               _     ___
+ * Waveform "0":   | |___| |___  "1":     |   |_|   |_  "F":      | |___|   |_
+ */
+bool PulseTrain::compileTriState(const char* sCodeWord, const RCSwitchProtocol& protocol, unsigned int nPulseLength) {
+  this->clear();
+  return this->addTriState(sCodeWord, protocol, nPulseLength);
+}
+
+/**
+ * Appends a tri-state code word and its sync to what is already compiled,
+ * so several frames can be played as one train.
+ */
+bool PulseTrain::addTriState(const char* sCodeWord, const RCSwitchProtocol& protocol, unsigned int nPulseLength) {
+  if (sCodeWord == NULL) {
+    return false;
+  }
+  for (const char* c = sCodeWord; *c != '\0'; c++) {
+    switch (*c) {
+      case '0':
+        this->addPulses(1, 3, nPulseLength);
+        this->addPulses(1, 3, nPulseLength);
+        break;
+      case 'F':
+        this->addPulses(1, 3, nPulseLength);
+        this->addPulses(3, 1, nPulseLength);
+        break;
+      case '1':
+        this->addPulses(3, 1, nPulseLength);
+        this->addPulses(3, 1, nPulseLength);
+        break;
+    }
+  }
+  this->addPulses(protocol.sync, protocol.inverted, nPulseLength);
+  return true;
+}
+
+const unsigned int* PulseTrain::getDurations() const {
+  return this->durations.data();
+}
+
+unsigned int PulseTrain::size() const {
+  return this->durations.size();
+}
+
+/**
+ * Level of the first duration; the following ones alternate.
+ */
+int PulseTrain::getFirstLevel() const {
+  return this->nFirstLevel;
+}
+
+/**
+ * Time on air of one frame, in microseconds.
+ */
+unsigned long PulseTrain::getLength() const {
+  unsigned long length = 0;
+  for (unsigned int i = 0; i < this->durations.size(); i++) {
+    length += this->durations[i];
+  }
+  return length;
+}
+
+/**
+ * Same waveform: same first level and durations.
+ */
+bool PulseTrain::operator==(const PulseTrain& other) const {
+  return this->nFirstLevel == other.nFirstLevel && this->durations == other.durations;
+}
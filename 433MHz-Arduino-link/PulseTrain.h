@@ -0,0 +1,45 @@
+/*
+  PulseTrain - one frame as the level durations the transmitter has to produce.
+
+  RCSwitch compiles the frame (bits or tri-state code word, then the sync) into
+  a PulseTrain once, then plays it nRepeatTransmit times in one timed loop:
+  no per bit string walking, protocol lookups or receiver toggling while the
+  radio is on air. Consecutive levels that are the same (a zero length pulse
+  of an inverted protocol) are merged, so every entry is one edge.
+
+  Hardware independent: the durations can also be fed to RCSwitchDecoder.
+*/
+#ifndef _PulseTrain_h
+#define _PulseTrain_h
+
+#include <vector>
+#include "RCSwitchDecoder.h"
+
+class PulseTrain {
+
+  public:
+    PulseTrain();
+
+    void clear();
+    void addLevel(int nLevel, unsigned int nDuration);
+    void addPulses(unsigned int nHighPulses, unsigned int nLowPulses, unsigned int nPulseLength);
+    void addPulses(RCSwitchPulses pulses, bool bInverted, unsigned int nPulseLength);
+
+    bool compile(unsigned long long code, unsigned int nLength, const RCSwitchProtocol& protocol, unsigned int nPulseLength);
+    bool compile(const char* sCodeWord, const RCSwitchProtocol& protocol, unsigned int nPulseLength);
+    bool compileTriState(const char* sCodeWord, const RCSwitchProtocol& protocol, unsigned int nPulseLength);
+    bool addTriState(const char* sCodeWord, const RCSwitchProtocol& protocol, unsigned int nPulseLength);
+
+    const unsigned int* getDurations() const;
+    unsigned int size() const;
+    int getFirstLevel() const;
+    unsigned long getLength() const;
+
+    bool operator==(const PulseTrain& other) const;
+
+  private:
+    std::vector<unsigned int> durations;
+    int nFirstLevel;
+};
+
+#endif
@@ -0,0 +1,222 @@
+/*
+  RCBench: measures the RCSwitch decoder on synthetic signals (see SignalGenerator.h).
+
+  Generates n transmissions of random codes with the given protocol, repeat count
+  and noise, then runs them through RCSwitchDecoder twice:
+  - once flat out, to get decoded frames/s and edges/s
+  - once timing every handleDuration() call, to get the latency of the call
+    that completes a frame (p50/p90/p99/max)
+  A transmission counts as decoded if its code came out at least once, cleanly or
+  rebuilt by majority vote over its repeats (which completes only with the next
+  transmission); any frame that is neither its code nor the colliding station's
+  is a false decode.
+
+  Usage: RCBench [-p protocol] [-b bits] [-r repeats] [-n transmissions]
+                 [-j jitter %] [-d dropped edge %] [-g glitch %] [-c collision %]
+                 [-t tolerance %] [-k station bits] [-x] [-e] [-s seed]
+  With -k the decoder learns per station windows (the first k bits of the random
+  codes are the station) and the learned windows of station 0 are printed. Only
+  the stations with the first of those bits clear send, so the others must not
+  learn anything: RCBench fails if they do (e.g. -k 4 -e, where the station is
+  in the data bits of the coded frame, not in its first bits on air).
+  With -x the last 8 of the bits are a CRC of the others (see FrameCheck.h) and
+  the decoder drops the frames that do not match.
+  With -e the bits (CRC included) are sent Hamming coded (see HammingCode.h),
+  e.g. 40 bits as 47, and the decoder corrects them: compare the success rate
+  at fewer repeats (-r) with and without it.
+*/
+
+#include "RCSwitchDecoder.h"
+#include "SignalGenerator.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <time.h>
+#include <vector>
+#include <algorithm>
+
+static unsigned long long nowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static unsigned long long percentile(std::vector<unsigned long long>& sorted, double p) {
+    if (sorted.empty()) {
+        return 0;
+    }
+    size_t index = (size_t)(p / 100.0 * (sorted.size() - 1) + 0.5);
+    return sorted[index];
+}
+
+int main(int argc, char *argv[]) {
+
+    SignalOptions options = SignalGenerator::defaults();
+    unsigned int transmissions = 10000;
+    int tolerance = 60;
+    unsigned int seed = 1;
+    unsigned int stationBits = 0;
+    bool check = false;
+    bool fec = false;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "p:b:r:n:j:d:g:c:t:k:xes:")) != -1) {
+        switch (opt) {
+            case 'p': options.nProtocol = atoi(optarg); break;
+            case 'b': options.nBits = atoi(optarg); break;
+            case 'r': options.nRepeats = atoi(optarg); break;
+            case 'n': transmissions = atoi(optarg); break;
+            case 'j': options.jitter = atof(optarg) / 100.0; break;
+            case 'd': options.dropRate = atof(optarg) / 100.0; break;
+            case 'g': options.glitchRate = atof(optarg) / 100.0; break;
+            case 'c': options.collisionRate = atof(optarg) / 100.0; break;
+            case 't': tolerance = atoi(optarg); break;
+            case 'k': stationBits = atoi(optarg); break;
+            case 'x': check = true; break;
+            case 'e': fec = true; break;
+            case 's': seed = atoi(optarg); break;
+            default:
+                fprintf(stderr, "usage: %s [-p protocol] [-b bits] [-r repeats] [-n transmissions] [-j jitter %%] "
+                                "[-d dropped edge %%] [-g glitch %%] [-c collision %%] [-t tolerance %%] [-k station bits] [-x] [-e] [-s seed]\n", argv[0]);
+                return 1;
+        }
+    }
+    if (RCSwitchDecoder::getProtocol(options.nProtocol) == NULL || options.nBits < 4 || options.nBits > RCSWITCH_MAX_BITS) {
+        fprintf(stderr, "unknown protocol or bit length out of 4..%d\n", RCSWITCH_MAX_BITS);
+        return 1;
+    }
+    if (check && options.nBits <= FRAME_CHECK_BITS + 4) {
+        fprintf(stderr, "-x needs more than %d bits\n", FRAME_CHECK_BITS + 4);
+        return 1;
+    }
+    if (fec && HammingCode::codedBits(options.nBits) > RCSWITCH_MAX_BITS) {
+        fprintf(stderr, "-e takes at most %d bits\n", HammingCode::dataBits(RCSWITCH_MAX_BITS));
+        return 1;
+    }
+    // -b is the data, with -e more bits go on air; the application gets the data without the CRC
+    unsigned int dataBits = options.nBits;
+    unsigned int payloadBits = check ? dataBits - FRAME_CHECK_BITS : dataBits;
+    if (stationBits > RCSWITCH_MAX_STATION_BITS || stationBits >= payloadBits) {
+        fprintf(stderr, "-k takes at most %d bits\n", RCSWITCH_MAX_STATION_BITS);
+        return 1;
+    }
+    if (fec) {
+        options.nBits = HammingCode::codedBits(dataBits);
+    }
+
+    // generate everything up front so only the decoder is measured
+    SignalGenerator generator(seed);
+    std::vector<unsigned int> durations;
+    std::vector<size_t> ends(transmissions);
+    std::vector<unsigned long long> codes(transmissions), colliders(transmissions);
+    for (unsigned int i = 0; i < transmissions; i++) {
+        // codes[] is the payload the decoder reports, the CRC and the Hamming parity are only on air
+        codes[i] = generator.randomCode(payloadBits);
+        if (stationBits > 0) {
+            // half the stations stay silent
+            codes[i] &= ~(1ULL << (payloadBits - 1));
+        }
+        unsigned long long data = check ? FrameCheck::append(codes[i], payloadBits) : codes[i];
+        generator.transmission(options, fec ? HammingCode::encode(data, dataBits) : data, durations, &colliders[i]);
+        ends[i] = durations.size();
+    }
+
+    printf("protocol %d, %u bits, %u repeats, %u transmissions, jitter %.1f%%, dropped edges %.2f%%, "
+           "glitches %.2f%%, collisions %.1f%%, tolerance %d%%\n",
+           options.nProtocol, options.nBits, options.nRepeats, transmissions, options.jitter * 100,
+           options.dropRate * 100, options.glitchRate * 100, options.collisionRate * 100, tolerance);
+
+    // pass 1: throughput and decode success
+    RCSwitchDecoder decoder;
+    decoder.setReceiveTolerance(tolerance);
+    decoder.setStationBits(stationBits);
+    decoder.setCheckedBitlength(check ? dataBits : 0);
+    decoder.setCodedBitlength(fec ? options.nBits : 0);
+    RCSwitchFrame frames[RCSWITCH_FRAME_BUFFER];
+    unsigned long long frameCount = 0, decodedCount = 0, falseCount = 0, colliderCount = 0, votedCount = 0, otherCount = 0;
+    std::vector<bool> decoded(transmissions, false);
+    size_t start = 0;
+
+    unsigned long long startTime = nowNs();
+    for (unsigned int i = 0; i < transmissions; i++) {
+        for (size_t d = start; d < ends[i]; d++) {
+            decoder.handleDuration(durations[d]);
+        }
+        start = ends[i];
+
+        unsigned int count = decoder.drain(frames, RCSWITCH_FRAME_BUFFER);
+        for (unsigned int f = 0; f < count; f++) {
+            // with -x or -e a frame that was not checked or corrected is not a sensor frame, the application skips it
+            if ((check && !frames[f].checked) || (fec && frames[f].bitlength != payloadBits)) {
+                otherCount++;
+                continue;
+            }
+            // a majority vote completes at the first edge after the transmission: the next one's
+            unsigned int t = frames[f].value == codes[i] || i == 0 || frames[f].value != codes[i - 1] ? i : i - 1;
+            if (frames[f].value == codes[t]) {
+                votedCount += frames[f].voted && !decoded[t];
+                decoded[t] = true;
+            } else if (colliders[i] != 0 && frames[f].value == colliders[i]) {
+                colliderCount++;
+            } else {
+                falseCount++;
+            }
+        }
+        frameCount += count;
+    }
+    double elapsed = (nowNs() - startTime) / 1e9;
+    decodedCount = std::count(decoded.begin(), decoded.end(), true);
+
+    printf("decoded %llu/%u transmissions (%.2f%%, %llu by majority vote), %llu false decodes, %llu colliding station frames, %lu dropped\n",
+           decodedCount, transmissions, 100.0 * decodedCount / transmissions, votedCount, falseCount, colliderCount,
+           decoder.getDroppedFrames());
+    if (check || fec) {
+        printf("%lu repeats passed the CRC, %lu dropped as corrupt, %lu bits corrected, %llu frames of other lengths not counted above\n",
+               decoder.getCheckedFrames(), decoder.getCorruptFrames(), decoder.getCorrectedBits(), otherCount);
+    }
+    printf("throughput: %.0f frames/s, %.0f edges/s (%llu frames, %zu edges in %.3fs)\n",
+           frameCount / elapsed, durations.size() / elapsed, frameCount, durations.size(), elapsed);
+
+    // pass 2: latency of the handleDuration() call that completes each frame
+    RCSwitchDecoder timed;
+    timed.setReceiveTolerance(tolerance);
+    timed.setStationBits(stationBits);
+    timed.setCheckedBitlength(check ? dataBits : 0);
+    timed.setCodedBitlength(fec ? options.nBits : 0);
+    RCSwitchFrame frame;
+    std::vector<unsigned long long> latencies;
+    latencies.reserve(frameCount);
+    for (size_t d = 0; d < durations.size(); d++) {
+        unsigned long long before = nowNs();
+        timed.handleDuration(durations[d]);
+        unsigned long long after = nowNs();
+        while (timed.popFrame(frame)) {
+            latencies.push_back(after - before);
+        }
+    }
+    std::sort(latencies.begin(), latencies.end());
+    printf("latency per frame: p50 %lluns, p90 %lluns, p99 %lluns, max %lluns\n",
+           percentile(latencies, 50), percentile(latencies, 90), percentile(latencies, 99),
+           latencies.empty() ? 0 : latencies.back());
+
+    RCSwitchCalibration calibration;
+    if (stationBits > 0 && decoder.getCalibration(options.nProtocol, 0, calibration)) {
+        printf("station 0 learned from %u frames: 0 = %u..%u%% / %u..%u%%, 1 = %u..%u%% / %u..%u%% of the pulse length\n",
+               calibration.frames, calibration.zeroFirst.low, calibration.zeroFirst.high,
+               calibration.zeroSecond.low, calibration.zeroSecond.high, calibration.oneFirst.low,
+               calibration.oneFirst.high, calibration.oneSecond.low, calibration.oneSecond.high);
+    }
+    // a colliding station may be any of them
+    if (stationBits > 0 && options.collisionRate == 0) {
+        unsigned int silent = 0;
+        for (unsigned int s = 1u << (stationBits - 1); s < (1u << stationBits); s++) {
+            silent += decoder.getCalibration(options.nProtocol, s, calibration);
+        }
+        if (silent > 0) {
+            printf("FAILED: %u stations that never sent learned windows\n", silent);
+            exit(1);
+        }
+    }
+
+    exit(0);
+}
@@ -0,0 +1,114 @@
+/*
+  RCReplay: plays a capture recorded by RFRcvCmplxData (see EdgeCapture.h) back
+  through the same decoder the receiver uses, as fast as the CPU allows.
+
+  Use it to reproduce what happened in the field and to measure decoder changes
+  on any Linux box: it does not need wiringPi or a radio.
+
+  Usage: RCReplay [-k station bits] [-x] [-e] [-q] <capture file> [tolerance %]
+  - tolerance defaults to 60%, like RCSwitch
+  - -k, -x and -e set the decoder up like the receivers (and RCBench): -k learns
+    per station windows, -x checks the CRC of 40 bit frames, -e corrects them
+    sent Hamming coded (47 bits)
+  - -q only prints the summary, not every frame
+*/
+
+#include "RCSwitchDecoder.h"
+#include "EdgeCapture.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <time.h>
+
+// durations decoded per batch: small enough that the frame queue can't overflow in between
+#define REPLAY_BATCH 256
+// what the sketch sends with USE_CRC: a 32 bit reading and its CRC
+#define REPLAY_CHECKED_BITS 40
+
+static double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int usage(const char* name) {
+    fprintf(stderr, "usage: %s [-k station bits] [-x] [-e] [-q] <capture file> [tolerance %%]\n", name);
+    return 1;
+}
+
+int main(int argc, char *argv[]) {
+
+    const char* path = NULL;
+    int tolerance = 60;
+    unsigned int stationBits = 0;
+    bool check = false;
+    bool fec = false;
+    bool quiet = false;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "k:xeq")) != -1) {
+        switch (opt) {
+            case 'k': stationBits = atoi(optarg); break;
+            case 'x': check = true; break;
+            case 'e': fec = true; break;
+            case 'q': quiet = true; break;
+            default: return usage(argv[0]);
+        }
+    }
+    if (optind >= argc) {
+        return usage(argv[0]);
+    }
+    path = argv[optind];
+    if (optind + 1 < argc) {
+        tolerance = atoi(argv[optind + 1]);
+    }
+
+    EdgeCaptureReader reader;
+    if (!reader.open(path)) {
+        fprintf(stderr, "%s is not a readable capture\n", path);
+        return 1;
+    }
+    printf("capture of pin %d, clock %s\n", reader.getPin(),
+           reader.getClockSource() == EDGE_CLOCK_KERNEL ? "kernel" : "micros");
+
+    RCSwitchDecoder decoder;
+    decoder.setReceiveTolerance(tolerance);
+    decoder.setStationBits(stationBits);
+    decoder.setCheckedBitlength(check ? REPLAY_CHECKED_BITS : 0);
+    decoder.setCodedBitlength(fec ? HammingCode::codedBits(REPLAY_CHECKED_BITS) : 0);
+
+    unsigned int durations[REPLAY_BATCH];
+    RCSwitchFrame frames[RCSWITCH_FRAME_BUFFER];
+    unsigned long long edgeCount = 0, frameCount = 0;
+    unsigned int count;
+
+    double startTime = now();
+    while ((count = reader.read(durations, REPLAY_BATCH)) > 0) {
+        for (unsigned int i = 0; i < count; i++) {
+            decoder.handleDuration(durations[i]);
+        }
+        edgeCount += count;
+
+        unsigned int frameTotal = decoder.drain(frames, RCSWITCH_FRAME_BUFFER);
+        frameCount += frameTotal;
+        if (!quiet) {
+            for (unsigned int f = 0; f < frameTotal; f++) {
+                printf("Received %llu / %ubit Protocol: %u delay %u repeats %u%s%s\n",
+                       frames[f].value, frames[f].bitlength, frames[f].protocol, frames[f].delay,
+                       frames[f].repeats, frames[f].voted ? " (majority vote)" : "",
+                       frames[f].checked ? " (checked)" : "");
+            }
+        }
+    }
+    double elapsed = now() - startTime;
+
+    printf("%llu edges, %llu frames (%lu dropped) in %.3fs: %.0f edges/s, %.0f frames/s\n",
+           edgeCount, frameCount, decoder.getDroppedFrames(), elapsed,
+           elapsed > 0 ? edgeCount / elapsed : 0, elapsed > 0 ? frameCount / elapsed : 0);
+    if (check || fec) {
+        printf("%lu repeats passed the CRC, %lu dropped as corrupt, %lu bits corrected\n",
+               decoder.getCheckedFrames(), decoder.getCorruptFrames(), decoder.getCorrectedBits());
+    }
+
+    exit(0);
+}
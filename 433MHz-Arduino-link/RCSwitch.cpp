@@ -25,18 +25,17 @@
 */
 
 #include "RCSwitch.h"
-
-unsigned long RCSwitch::nReceivedValue = NULL;
-unsigned int RCSwitch::nReceivedBitlength = 0;
-unsigned int RCSwitch::nReceivedDelay = 0;
-unsigned int RCSwitch::nReceivedProtocol = 0;
-unsigned int RCSwitch::timings[RCSWITCH_MAX_CHANGES];
-int RCSwitch::nReceiveTolerance = 60;
+#include <string.h>
 
 RCSwitch::RCSwitch() {
   this->nReceiverInterrupt = -1;
   this->nTransmitterPin = -1;
-  RCSwitch::nReceivedValue = NULL;
+  this->transmitter = NULL;
+  this->receiver = NULL;
+  this->bReceivedFrame = false;
+  this->nStationBits = 0;
+  this->nCheckedBitlength = 0;
+  this->nCodedBitlength = 0;
   this->setPulseLength(350);
   this->setRepeatTransmit(10);
   this->setReceiveTolerance(60);
@@ -47,12 +46,10 @@ RCSwitch::RCSwitch() {
   * Sets the protocol to send.
   */
 void RCSwitch::setProtocol(int nProtocol) {
-  this->nProtocol = nProtocol;
-  if (nProtocol == 1){
-	  this->setPulseLength(350);
-  }
-  else if (nProtocol == 2) {
-	  this->setPulseLength(650);
+  const RCSwitchProtocol* protocol = RCSwitch::getProtocol(nProtocol);
+  if (protocol != NULL) {
+    this->nProtocol = nProtocol;
+    this->setPulseLength(protocol->pulseLength);
   }
 }
 
@@ -60,15 +57,23 @@ void RCSwitch::setProtocol(int nProtocol) {
   * Sets the protocol to send with pulse length in microseconds.
   */
 void RCSwitch::setProtocol(int nProtocol, int nPulseLength) {
-  this->nProtocol = nProtocol;
-  if (nProtocol == 1){
-	  this->setPulseLength(nPulseLength);
-  }
-  else if (nProtocol == 2) {
-	  this->setPulseLength(nPulseLength);
+  if (RCSwitch::getProtocol(nProtocol) != NULL) {
+    this->nProtocol = nProtocol;
+    this->setPulseLength(nPulseLength);
   }
 }
 
+/**
+  * Returns the waveform description of protocol nProtocol (1..getProtocolCount()), NULL if unknown.
+  */
+const RCSwitchProtocol* RCSwitch::getProtocol(int nProtocol) {
+  return RCSwitchDecoder::getProtocol(nProtocol);
+}
+
+unsigned int RCSwitch::getProtocolCount() {
+  return RCSwitchDecoder::getProtocolCount();
+}
+
 
 /**
   * Sets pulse length in microseconds
@@ -88,7 +93,53 @@ void RCSwitch::setRepeatTransmit(int nRepeatTransmit) {
  * Set Receiving Tolerance
  */
 void RCSwitch::setReceiveTolerance(int nPercent) {
-  RCSwitch::nReceiveTolerance = nPercent;
+  this->nReceiveTolerance = nPercent;
+  if (this->receiver != NULL) {
+    this->receiver->getDecoder().setReceiveTolerance(nPercent);
+  }
+}
+
+/**
+ * Learn acceptance windows per station, the station being the first nBits bits
+ * of each frame (see RCSwitchDecoder::setStationBits)
+ */
+void RCSwitch::setStationBits(unsigned int nBits) {
+  this->nStationBits = nBits;
+  if (this->receiver != NULL) {
+    this->receiver->getDecoder().setStationBits(nBits);
+  }
+}
+
+/**
+ * Frames of nBits bits end in a CRC and are dropped when it does not match
+ * (see RCSwitchDecoder::setCheckedBitlength)
+ */
+void RCSwitch::setCheckedBitlength(unsigned int nBits) {
+  this->nCheckedBitlength = nBits;
+  if (this->receiver != NULL) {
+    this->receiver->getDecoder().setCheckedBitlength(nBits);
+  }
+}
+
+/**
+ * Frames of nBits bits are Hamming coded and get corrected
+ * (see RCSwitchDecoder::setCodedBitlength)
+ */
+void RCSwitch::setCodedBitlength(unsigned int nBits) {
+  this->nCodedBitlength = nBits;
+  if (this->receiver != NULL) {
+    this->receiver->getDecoder().setCodedBitlength(nBits);
+  }
+}
+
+/**
+ * What the receiver learned about a station's pulse widths, see RCSwitchDecoder::getCalibration
+ */
+bool RCSwitch::getCalibration(int nProtocol, unsigned int nStation, RCSwitchCalibration& calibration) {
+  if (this->receiver == NULL) {
+    return false;
+  }
+  return this->receiver->getDecoder().getCalibration(nProtocol, nStation, calibration);
 }
   
 
@@ -99,6 +150,7 @@ void RCSwitch::setReceiveTolerance(int nPercent) {
  */
 void RCSwitch::enableTransmit(int nTransmitterPin) {
   this->nTransmitterPin = nTransmitterPin;
+  this->transmitter = RCSwitchTransmitter::get(nTransmitterPin);
   pinMode(this->nTransmitterPin, OUTPUT);
 }
 
@@ -107,6 +159,7 @@ void RCSwitch::enableTransmit(int nTransmitterPin) {
   */
 void RCSwitch::disableTransmit() {
   this->nTransmitterPin = -1;
+  this->transmitter = NULL;
 }
 
 /**
@@ -117,7 +170,7 @@ void RCSwitch::disableTransmit() {
  * @param nDevice  Number of device (1..4)
   */
 void RCSwitch::switchOn(char sFamily, int nGroup, int nDevice) {
-  this->sendTriState( this->getCodeWordC(sFamily, nGroup, nDevice, true) );
+  this->sendTriState( OutletCode::typeC(sFamily, nGroup, nDevice, true).get() );
 }
 
 /**
@@ -128,7 +181,7 @@ void RCSwitch::switchOn(char sFamily, int nGroup, int nDevice) {
  * @param nDevice  Number of device (1..4)
  */
 void RCSwitch::switchOff(char sFamily, int nGroup, int nDevice) {
-  this->sendTriState( this->getCodeWordC(sFamily, nGroup, nDevice, false) );
+  this->sendTriState( OutletCode::typeC(sFamily, nGroup, nDevice, false).get() );
 }
 
 /**
@@ -138,7 +191,7 @@ void RCSwitch::switchOff(char sFamily, int nGroup, int nDevice) {
  * @param nChannelCode  Number of the switch itself (1..4)
  */
 void RCSwitch::switchOn(int nAddressCode, int nChannelCode) {
-  this->sendTriState( this->getCodeWordB(nAddressCode, nChannelCode, true) );
+  this->sendTriState( OutletCode::typeB(nAddressCode, nChannelCode, true).get() );
 }
 
 /**
@@ -148,7 +201,7 @@ void RCSwitch::switchOn(int nAddressCode, int nChannelCode) {
  * @param nChannelCode  Number of the switch itself (1..4)
  */
 void RCSwitch::switchOff(int nAddressCode, int nChannelCode) {
-  this->sendTriState( this->getCodeWordB(nAddressCode, nChannelCode, false) );
+  this->sendTriState( OutletCode::typeB(nAddressCode, nChannelCode, false).get() );
 }
 
 /**
@@ -158,7 +211,7 @@ void RCSwitch::switchOff(int nAddressCode, int nChannelCode) {
  * @param nChannelCode  Number of the switch itself (1..4)
  */
 void RCSwitch::switchOn(char* sGroup, int nChannel) {
-  this->sendTriState( this->getCodeWordA(sGroup, nChannel, true) );
+  this->sendTriState( OutletCode::typeA(sGroup, nChannel, true).get() );
 }
 
 /**
@@ -168,452 +221,348 @@ void RCSwitch::switchOn(char* sGroup, int nChannel) {
  * @param nChannelCode  Number of the switch itself (1..4)
  */
 void RCSwitch::switchOff(char* sGroup, int nChannel) {
-  this->sendTriState( this->getCodeWordA(sGroup, nChannel, false) );
+  this->sendTriState( OutletCode::typeA(sGroup, nChannel, false).get() );
 }
 
 /**
- * Returns a char[13], representing the Code Word to be send.
- * A Code Word consists of 9 address bits, 3 data bits and one sync bit but in our case only the first 8 address bits and the last 2 data bits were used.
- * A Code Bit can have 4 different states: "F" (floating), "0" (low), "1" (high), "S" (synchronous bit)
- *
- * +-------------------------------+--------------------------------+-----------------------------------------+-----------------------------------------+----------------------+------------+
- * | 4 bits address (switch group) | 4 bits address (switch number) | 1 bit address (not used, so never mind) | 1 bit address (not used, so never mind) | 2 data bits (on|off) | 1 sync bit |
- * | 1=0FFF 2=F0FF 3=FF0F 4=FFF0   | 1=0FFF 2=F0FF 3=FF0F 4=FFF0    | F                                       | F                                       | on=FF off=F0         | S          |
- * +-------------------------------+--------------------------------+-----------------------------------------+-----------------------------------------+----------------------+------------+
+ * The switchOn()/switchOff() methods without waiting for the radio: the burst
+ * is queued (see RCSwitchTransmitter.h) and the returned future becomes true
+ * once it was sent.
+ */
+std::shared_future<bool> RCSwitch::switchOnAsync(char sFamily, int nGroup, int nDevice) {
+  return this->enqueueTriState( OutletCode::typeC(sFamily, nGroup, nDevice, true).get() );
+}
+
+std::shared_future<bool> RCSwitch::switchOffAsync(char sFamily, int nGroup, int nDevice) {
+  return this->enqueueTriState( OutletCode::typeC(sFamily, nGroup, nDevice, false).get() );
+}
+
+std::shared_future<bool> RCSwitch::switchOnAsync(int nAddressCode, int nChannelCode) {
+  return this->enqueueTriState( OutletCode::typeB(nAddressCode, nChannelCode, true).get() );
+}
+
+std::shared_future<bool> RCSwitch::switchOffAsync(int nAddressCode, int nChannelCode) {
+  return this->enqueueTriState( OutletCode::typeB(nAddressCode, nChannelCode, false).get() );
+}
+
+std::shared_future<bool> RCSwitch::switchOnAsync(char* sGroup, int nChannel) {
+  return this->enqueueTriState( OutletCode::typeA(sGroup, nChannel, true).get() );
+}
+
+std::shared_future<bool> RCSwitch::switchOffAsync(char* sGroup, int nChannel) {
+  return this->enqueueTriState( OutletCode::typeA(sGroup, nChannel, false).get() );
+}
+
+/**
+ * Switches several outlets in one burst and waits until it is on air.
  *
- * @param nAddressCode  Number of the switch group (1..4)
- * @param nChannelCode  Number of the switch itself (1..4)
- * @param bStatus       Wether to switch on (true) or off (false)
+ * Every round of the burst sends each outlet's frame once, and the rounds are
+ * repeated nRepeatTransmit times: every outlet hears its first frame within
+ * the first round instead of after all repeats of the ones before it, and the
+ * whole set is one queued burst, with one receiver suspension, instead of one
+ * per outlet. When a set has several commands for the same outlet the last
+ * one is sent.
  *
- * @return char[13]
- */
-char* RCSwitch::getCodeWordB(int nAddressCode, int nChannelCode, boolean bStatus) {
-   int nReturnPos = 0;
-   static char sReturn[13];
-   
-   const char* code[5] = { "FFFF", "0FFF", "F0FF", "FF0F", "FFF0" };
-   if (nAddressCode < 1 || nAddressCode > 4 || nChannelCode < 1 || nChannelCode > 4) {
-    return '\0';
-   }
-   for (int i = 0; i<4; i++) {
-     sReturn[nReturnPos++] = code[nAddressCode][i];
-   }
-
-   for (int i = 0; i<4; i++) {
-     sReturn[nReturnPos++] = code[nChannelCode][i];
-   }
-   
-   sReturn[nReturnPos++] = 'F';
-   sReturn[nReturnPos++] = 'F';
-   sReturn[nReturnPos++] = 'F';
-   
-   if (bStatus) {
-      sReturn[nReturnPos++] = 'F';
-   } else {
-      sReturn[nReturnPos++] = '0';
-   }
-   
-   sReturn[nReturnPos] = '\0';
-   
-   return sReturn;
-}
-
-
-/**
- * Like getCodeWord  (Type A)
- */
-char* RCSwitch::getCodeWordA(char* sGroup, int nChannelCode, boolean bStatus) {
-   int nReturnPos = 0;
-   static char sReturn[13];
-
-  const char* code[6] = { "FFFFF", "0FFFF", "F0FFF", "FF0FF", "FFF0F", "FFFF0" };
-
-  if (nChannelCode < 1 || nChannelCode > 5) {
-      return '\0';
-  }
-  
-  for (int i = 0; i<5; i++) {
-    if (sGroup[i] == '0') {
-      sReturn[nReturnPos++] = 'F';
-    } else if (sGroup[i] == '1') {
-      sReturn[nReturnPos++] = '0';
-    } else {
-      return '\0';
-    }
-  }
-  
-  for (int i = 0; i<5; i++) {
-    sReturn[nReturnPos++] = code[ nChannelCode ][i];
-  }
-  
-  if (bStatus) {
-    sReturn[nReturnPos++] = '0';
-    sReturn[nReturnPos++] = 'F';
-  } else {
-    sReturn[nReturnPos++] = 'F';
-    sReturn[nReturnPos++] = '0';
-  }
-  sReturn[nReturnPos] = '\0';
-
-  return sReturn;
+ * @param codes   Code words, e.g. OutletCode::typeC('a', 1, 2, true)
+ * @param nCount  Number of codes
+ */
+void RCSwitch::switchBatch(const OutletCode* codes, unsigned int nCount) {
+  this->switchBatchAsync(codes, nCount).wait();
 }
 
 /**
- * Like getCodeWord (Type C = Intertechno)
+ * switchBatch() without waiting for the radio
+ *
+ * @return becomes true once sent, false if there was no valid code or it could not be queued
  */
-char* RCSwitch::getCodeWordC(char sFamily, int nGroup, int nDevice, boolean bStatus) {
-  static char sReturn[13];
-  int nReturnPos = 0;
-  
-  if ( (byte)sFamily < 97 || (byte)sFamily > 112 || nGroup < 1 || nGroup > 4 || nDevice < 1 || nDevice > 4) {
-    return '\0';
-  }
-  
-  char* sDeviceGroupCode =  dec2binWzerofill(  (nDevice-1) + (nGroup-1)*4, 4  );
-  char familycode[16][5] = { "0000", "F000", "0F00", "FF00", "00F0", "F0F0", "0FF0", "FFF0", "000F", "F00F", "0F0F", "FF0F", "00FF", "F0FF", "0FFF", "FFFF" };
-  for (int i = 0; i<4; i++) {
-    sReturn[nReturnPos++] = familycode[ (int)sFamily - 97 ][i];
-  }
-  for (int i = 0; i<4; i++) {
-    sReturn[nReturnPos++] = (sDeviceGroupCode[3-i] == '1' ? 'F' : '0');
+std::shared_future<bool> RCSwitch::switchBatchAsync(const OutletCode* codes, unsigned int nCount) {
+  const RCSwitchProtocol& protocol = *RCSwitch::getProtocol(this->nProtocol);
+  PulseTrain train;
+  for (unsigned int i = 0; i < nCount; i++) {
+    if (!codes[i].isValid()) {
+      continue;
+    }
+    // the first 10 code bits are the address of the outlet, the last 2 are on/off
+    bool bOverridden = false;
+    for (unsigned int j = i + 1; j < nCount && !bOverridden; j++) {
+      bOverridden = codes[j].isValid() && strncmp(codes[i].sCodeWord, codes[j].sCodeWord, 10) == 0;
+    }
+    if (!bOverridden) {
+      train.addTriState(codes[i].get(), protocol, this->nPulseLength);
+    }
   }
-  sReturn[nReturnPos++] = '0';
-  sReturn[nReturnPos++] = 'F';
-  sReturn[nReturnPos++] = 'F';
-  if (bStatus) {
-    sReturn[nReturnPos++] = 'F';
-  } else {
-    sReturn[nReturnPos++] = '0';
+  if (train.size() == 0) {
+    return RCSwitchTransmitter::refused();
   }
-  sReturn[nReturnPos] = '\0';
-  return sReturn;
+  return this->transmit(train);
 }
 
 /**
- * Sends a Code Word
+ * Sends a Code Word and waits until it is on air nRepeatTransmit times
  * @param sCodeWord   /^[10FS]*$/  -> see getCodeWord
  */
-void RCSwitch::sendTriState(char* sCodeWord) {
-  for (int nRepeat=0; nRepeat<nRepeatTransmit; nRepeat++) {
-    int i = 0;
-    while (sCodeWord[i] != '\0') {
-      switch(sCodeWord[i]) {
-        case '0':
-          this->sendT0();
-        break;
-        case 'F':
-          this->sendTF();
-        break;
-        case '1':
-          this->sendT1();
-        break;
-      }
-      i++;
-    }
-    this->sendSync();    
-  }
+void RCSwitch::sendTriState(const char* sCodeWord) {
+  this->enqueueTriState(sCodeWord).wait();
 }
 
-void RCSwitch::send(unsigned long Code, unsigned int length) {
-  this->send( this->dec2binWzerofill(Code, length) );
+void RCSwitch::send(unsigned long long Code, unsigned int length) {
+  this->enqueue(Code, length).wait();
 }
 
 void RCSwitch::send(char* sCodeWord) {
-  for (int nRepeat=0; nRepeat<nRepeatTransmit; nRepeat++) {
-    int i = 0;
-    while (sCodeWord[i] != '\0') {
-      switch(sCodeWord[i]) {
-        case '0':
-          this->send0();
-        break;
-        case '1':
-          this->send1();
-        break;
-      }
-      i++;
-    }
-    this->sendSync();
-  }
+  this->enqueue(sCodeWord).wait();
 }
 
-void RCSwitch::transmit(int nHighPulses, int nLowPulses) {
-    boolean disabled_Receive = false;
-    int nReceiverInterrupt_backup = nReceiverInterrupt;
-    if (this->nTransmitterPin != -1) {
-        if (this->nReceiverInterrupt != -1) {
-            this->disableReceive();
-            disabled_Receive = true;
-        }
-        digitalWrite(this->nTransmitterPin, HIGH);
-        delayMicroseconds( this->nPulseLength * nHighPulses);
-        digitalWrite(this->nTransmitterPin, LOW);
-        delayMicroseconds( this->nPulseLength * nLowPulses);
-        if(disabled_Receive){
-            this->enableReceive(nReceiverInterrupt_backup);
-        }
-    }
-}
 /**
- * Sends a "0" Bit
- *                       _    
- * Waveform Protocol 1: | |___
- *                       _  
- * Waveform Protocol 2: | |__
+ * Sends nBits of data Hamming coded (see HammingCode.h), for a receiver
+ * that corrects HammingCode::codedBits(nBits) bit frames
+ *
+ * @param nBits  at most HAMMING_MAX_DATA_BITS
  */
-void RCSwitch::send0() {
-	if (this->nProtocol == 1){
-		this->transmit(1,3);
-	}
-	else if (this->nProtocol == 2) {
-		this->transmit(1,2);
-	}
+void RCSwitch::sendCoded(unsigned long long data, unsigned int nBits) {
+  this->enqueueCoded(data, nBits).wait();
 }
 
 /**
- * Sends a "1" Bit
- *                       ___  
- * Waveform Protocol 1: |   |_
- *                       __  
- * Waveform Protocol 2: |  |_
+ * Queues a Code Word without waiting for the radio
+ * @param sCodeWord   /^[10FS]*$/  -> see getCodeWord
+ *
+ * @return becomes true once sent, false if it could not be queued
  */
-void RCSwitch::send1() {
-  	if (this->nProtocol == 1){
-		this->transmit(3,1);
-	}
-	else if (this->nProtocol == 2) {
-		this->transmit(2,1);
-	}
+std::shared_future<bool> RCSwitch::enqueueTriState(const char* sCodeWord) {
+  PulseTrain train;
+  if (!train.compileTriState(sCodeWord, *RCSwitch::getProtocol(this->nProtocol), this->nPulseLength)) {
+    return RCSwitchTransmitter::refused();
+  }
+  return this->transmit(train);
 }
 
+std::shared_future<bool> RCSwitch::enqueue(unsigned long long Code, unsigned int length) {
+  PulseTrain train;
+  if (!train.compile(Code, length, *RCSwitch::getProtocol(this->nProtocol), this->nPulseLength)) {
+    return RCSwitchTransmitter::refused();
+  }
+  return this->transmit(train);
+}
 
-/**
- * Sends a Tri-State "0" Bit
- *            _     _
- * Waveform: | |___| |___
- */
-void RCSwitch::sendT0() {
-  this->transmit(1,3);
-  this->transmit(1,3);
+std::shared_future<bool> RCSwitch::enqueueCoded(unsigned long long data, unsigned int nBits) {
+  if (nBits == 0 || nBits > HAMMING_MAX_DATA_BITS) {
+    return RCSwitchTransmitter::refused();
+  }
+  return this->enqueue(HammingCode::encode(data, nBits), HammingCode::codedBits(nBits));
 }
 
-/**
- * Sends a Tri-State "1" Bit
- *            ___   ___
- * Waveform: |   |_|   |_
- */
-void RCSwitch::sendT1() {
-  this->transmit(3,1);
-  this->transmit(3,1);
+std::shared_future<bool> RCSwitch::enqueue(char* sCodeWord) {
+  PulseTrain train;
+  if (!train.compile(sCodeWord, *RCSwitch::getProtocol(this->nProtocol), this->nPulseLength)) {
+    return RCSwitchTransmitter::refused();
+  }
+  return this->transmit(train);
 }
 
 /**
- * Sends a Tri-State "F" Bit
- *            _     ___
- * Waveform: | |___|   |_
+ * Number of bursts queued or on air on the transmitter pin
  */
-void RCSwitch::sendTF() {
-  this->transmit(1,3);
-  this->transmit(3,1);
+unsigned int RCSwitch::getPendingTransmits() {
+  return this->transmitter != NULL ? this->transmitter->getPending() : 0;
 }
 
 /**
- * Sends a "Sync" Bit
- *                       _
- * Waveform Protocol 1: | |_______________________________
- *                       _
- * Waveform Protocol 2: | |__________
+ * Queues a compiled frame to be played nRepeatTransmit times by the pin's
+ * transmitter, which suspends our receiver while on air so we don't decode
+ * our own transmission.
  */
-void RCSwitch::sendSync() {
-
-    if (this->nProtocol == 1){
-		this->transmit(1,31);
-	}
-	else if (this->nProtocol == 2) {
-		this->transmit(1,10);
-	}
+std::shared_future<bool> RCSwitch::transmit(const PulseTrain& train) {
+    if (this->transmitter == NULL) {
+        return RCSwitchTransmitter::refused();
+    }
+    return this->transmitter->enqueue(train, this->nRepeatTransmit, this->receiver);
 }
 
 /**
  * Enable receiving data
+ *
+ * Every pin has its own receiver (see RCSwitchReceiver.h): one RCSwitch per
+ * pin can run in the same process, each decoded on its own thread.
  */
 void RCSwitch::enableReceive(int interrupt) {
   this->nReceiverInterrupt = interrupt;
   this->enableReceive();
 }
 
+/**
+ * Enable receiving data from any edge source (see EdgeSource.h), e.g. a
+ * FileEdgeSource to run without a radio. The source is taken over.
+ */
+void RCSwitch::enableReceive(EdgeSource* source) {
+  this->nReceiverInterrupt = -1;
+  this->useReceiver(RCSwitchReceiver::create(source));
+}
+
 void RCSwitch::enableReceive() {
   if (this->nReceiverInterrupt != -1) {
-    RCSwitch::nReceivedValue = NULL;
-    RCSwitch::nReceivedBitlength = NULL;
-    wiringPiISR(this->nReceiverInterrupt, INT_EDGE_BOTH, &handleInterrupt);
+    this->useReceiver(RCSwitchReceiver::get(this->nReceiverInterrupt));
+  } else if (this->receiver != NULL) {
+    this->receiver->enable();
+  }
+}
+
+void RCSwitch::useReceiver(RCSwitchReceiver* receiver) {
+  if (receiver == NULL) {
+    this->nReceiverInterrupt = -1;
+    return;
   }
+  if (receiver != this->receiver) {
+    this->receiver = receiver;
+    this->bReceivedFrame = false;
+    receiver->getDecoder().setReceiveTolerance(this->nReceiveTolerance);
+    receiver->getDecoder().setStationBits(this->nStationBits);
+    receiver->getDecoder().setCheckedBitlength(this->nCheckedBitlength);
+    receiver->getDecoder().setCodedBitlength(this->nCodedBitlength);
+  }
+  receiver->enable();
 }
 
 /**
  * Disable receiving data
  */
 void RCSwitch::disableReceive() {
+  if (this->receiver != NULL) {
+    this->receiver->disable();
+  }
   this->nReceiverInterrupt = -1;
 }
 
+/**
+ * True if a decoded frame is waiting; the getReceived* methods describe it
+ * until resetAvailable() moves on to the next one. Use drain() to take
+ * everything that is pending at once.
+ */
 bool RCSwitch::available() {
-  return RCSwitch::nReceivedValue != NULL;
+  if (!this->bReceivedFrame && this->receiver != NULL) {
+    this->bReceivedFrame = this->receiver->getDecoder().popFrame(this->receivedFrame);
+  }
+  return this->bReceivedFrame;
 }
 
 void RCSwitch::resetAvailable() {
-  RCSwitch::nReceivedValue = NULL;
+  this->bReceivedFrame = false;
 }
 
-unsigned long RCSwitch::getReceivedValue() {
-    return RCSwitch::nReceivedValue;
+/**
+ * Copies all pending decoded frames, oldest first, and removes them from the queue.
+ *
+ * @param frames     Where to store the frames
+ * @param maxFrames  Capacity of frames; RCSWITCH_FRAME_BUFFER always gets everything
+ *
+ * @return number of frames stored
+ */
+unsigned int RCSwitch::drain(RCSwitchFrame* frames, unsigned int maxFrames) {
+  unsigned int count = 0;
+  if (this->bReceivedFrame && count < maxFrames) {
+    frames[count++] = this->receivedFrame;
+    this->bReceivedFrame = false;
+  }
+  if (this->receiver == NULL) {
+    return count;
+  }
+  return count + this->receiver->getDecoder().drain(frames + count, maxFrames - count);
+}
+
+/**
+ * Sleeps until available() would be true, instead of calling it in a loop.
+ *
+ * @param nTimeout  Longest wait in milliseconds, -1 for no limit
+ *
+ * @return false if the time ran out without a frame, or receiving is not enabled
+ */
+bool RCSwitch::waitAvailable(int nTimeout) {
+  if (this->bReceivedFrame) {
+    return true;
+  }
+  return this->receiver != NULL && this->receiver->getDecoder().waitFrames(nTimeout);
+}
+
+/**
+ * A descriptor that polls readable when frames are pending, to wait for them
+ * together with other descriptors; drain() clears it.
+ *
+ * @return -1 if receiving is not enabled
+ */
+int RCSwitch::getReceiveFd() {
+  return this->receiver != NULL ? this->receiver->getDecoder().getFrameFd() : -1;
+}
+
+unsigned long long RCSwitch::getReceivedValue() {
+    return this->receivedFrame.value;
 }
 
 unsigned int RCSwitch::getReceivedBitlength() {
-  return RCSwitch::nReceivedBitlength;
+  return this->receivedFrame.bitlength;
 }
 
 unsigned int RCSwitch::getReceivedDelay() {
-  return RCSwitch::nReceivedDelay;
+  return this->receivedFrame.delay;
 }
 
 unsigned int RCSwitch::getReceivedProtocol() {
-  return RCSwitch::nReceivedProtocol;
+  return this->receivedFrame.protocol;
 }
 
 unsigned int* RCSwitch::getReceivedRawdata() {
-    return RCSwitch::timings;
+    return this->receiver != NULL ? this->receiver->getDecoder().getRawdata() : NULL;
 }
 
 /**
- *
+ * Number of edges lost because the decoder thread fell behind the interrupt handler
  */
-bool RCSwitch::receiveProtocol1(unsigned int changeCount){
-    
-	  unsigned long code = 0;
-      unsigned long delay = RCSwitch::timings[0] / 31;
-      unsigned long delayTolerance = delay * RCSwitch::nReceiveTolerance * 0.01;    
-
-      for (int i = 1; i<changeCount ; i=i+2) {
-      
-          if (RCSwitch::timings[i] > delay-delayTolerance && RCSwitch::timings[i] < delay+delayTolerance && RCSwitch::timings[i+1] > delay*3-delayTolerance && RCSwitch::timings[i+1] < delay*3+delayTolerance) {
-            code = code << 1;
-          } else if (RCSwitch::timings[i] > delay*3-delayTolerance && RCSwitch::timings[i] < delay*3+delayTolerance && RCSwitch::timings[i+1] > delay-delayTolerance && RCSwitch::timings[i+1] < delay+delayTolerance) {
-            code+=1;
-            code = code << 1;
-          } else {
-            // Failed
-            i = changeCount;
-            code = 0;
-          }
-      }      
-      code = code >> 1;
-    if (changeCount > 6) {    // ignore < 4bit values as there are no devices sending 4bit values => noise
-      RCSwitch::nReceivedValue = code;
-      RCSwitch::nReceivedBitlength = changeCount / 2;
-      RCSwitch::nReceivedDelay = delay;
-	  RCSwitch::nReceivedProtocol = 1;
-    }
-
-	if (code == 0){
-		return false;
-	}else if (code != 0){
-		return true;
-	}
-	
-
-}
-
-bool RCSwitch::receiveProtocol2(unsigned int changeCount){
-    
-	  unsigned long code = 0;
-      unsigned long delay = RCSwitch::timings[0] / 10;
-      unsigned long delayTolerance = delay * RCSwitch::nReceiveTolerance * 0.01;    
-
-      for (int i = 1; i<changeCount ; i=i+2) {
-      
-          if (RCSwitch::timings[i] > delay-delayTolerance && RCSwitch::timings[i] < delay+delayTolerance && RCSwitch::timings[i+1] > delay*2-delayTolerance && RCSwitch::timings[i+1] < delay*2+delayTolerance) {
-            code = code << 1;
-          } else if (RCSwitch::timings[i] > delay*2-delayTolerance && RCSwitch::timings[i] < delay*2+delayTolerance && RCSwitch::timings[i+1] > delay-delayTolerance && RCSwitch::timings[i+1] < delay+delayTolerance) {
-            code+=1;
-            code = code << 1;
-          } else {
-            // Failed
-            i = changeCount;
-            code = 0;
-          }
-      }      
-      code = code >> 1;
-    if (changeCount > 6) {    // ignore < 4bit values as there are no devices sending 4bit values => noise
-      RCSwitch::nReceivedValue = code;
-      RCSwitch::nReceivedBitlength = changeCount / 2;
-      RCSwitch::nReceivedDelay = delay;
-	  RCSwitch::nReceivedProtocol = 2;
-    }
-
-	if (code == 0){
-		return false;
-	}else if (code != 0){
-		return true;
-	}
-
+unsigned long RCSwitch::getDroppedEdges() {
+  return this->receiver != NULL ? this->receiver->getDroppedEdges() : 0;
 }
 
-void RCSwitch::handleInterrupt() {
-
-  static unsigned int duration;
-  static unsigned int changeCount;
-  static unsigned long lastTime;
-  static unsigned int repeatCount;
-
-  long time = micros();
-  duration = time - lastTime;
-
-  if (duration > 5000 && duration > RCSwitch::timings[0] - 200 && duration < RCSwitch::timings[0] + 200) {    
-    repeatCount++;
-    changeCount--;
+/**
+ * Number of decoded frames lost because the application did not drain the queue in time
+ */
+unsigned long RCSwitch::getDroppedFrames() {
+  return this->receiver != NULL ? this->receiver->getDecoder().getDroppedFrames() : 0;
+}
 
-    if (repeatCount == 2) {
-                if (receiveProtocol1(changeCount) == false){
-                        if (receiveProtocol2(changeCount) == false){
-                                //failed
-                        }
-                }
-      repeatCount = 0;
-    }
-    changeCount = 0;
-  } else if (duration > 5000) {
-    changeCount = 0;
-  }
+/**
+ * Number of frames that passed the CRC check
+ */
+unsigned long RCSwitch::getCheckedFrames() {
+  return this->receiver != NULL ? this->receiver->getDecoder().getCheckedFrames() : 0;
+}
 
-  if (changeCount >= RCSWITCH_MAX_CHANGES) {
-    changeCount = 0;
-    repeatCount = 0;
-  }
-  RCSwitch::timings[changeCount++] = duration;
-  lastTime = time;  
+/**
+ * Number of frames dropped because the CRC did not match or they could not be corrected
+ */
+unsigned long RCSwitch::getCorruptFrames() {
+  return this->receiver != NULL ? this->receiver->getDecoder().getCorruptFrames() : 0;
 }
 
 /**
-  * Turns a decimal value to its binary representation
-  */
-char* RCSwitch::dec2binWzerofill(unsigned long Dec, unsigned int bitLength){
-  static char bin[64];
-  unsigned int i=0;
+ * Number of bits the error correction fixed in the received frames
+ */
+unsigned long RCSwitch::getCorrectedBits() {
+  return this->receiver != NULL ? this->receiver->getDecoder().getCorrectedBits() : 0;
+}
 
-  while (Dec > 0) {
-    bin[32+i++] = ((Dec & 1) > 0) ? '1' : '0';
-    Dec = Dec >> 1;
-  }
+/**
+ * Records every edge the receiver sees to a capture file (see EdgeCapture.h)
+ * until stopCapture(). Call after enableReceive().
+ *
+ * @param path  File to write
+ *
+ * @return false if the file can not be created or receiving is not enabled
+ */
+bool RCSwitch::startCapture(const char* path) {
+  return this->receiver != NULL && this->receiver->startCapture(path);
+}
 
-  for (unsigned int j = 0; j< bitLength; j++) {
-    if (j >= bitLength - i) {
-      bin[j] = bin[ 31 + i - (j - (bitLength - i)) ];
-    }else {
-      bin[j] = '0';
-    }
+void RCSwitch::stopCapture() {
+  if (this->receiver != NULL) {
+    this->receiver->stopCapture();
   }
-  bin[bitLength] = '\0';
-  
-  return bin;
 }
 
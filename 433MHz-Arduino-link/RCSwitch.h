@@ -45,10 +45,11 @@ typedef uint8_t byte;
 #endif
 #endif
 
-
-// Number of maximum High/Low changes per packet.
-// We can handle up to (unsigned long) => 32 bit * 2 H/L changes per bit + 2 for sync
-#define RCSWITCH_MAX_CHANGES 67
+#include "RCSwitchDecoder.h"
+#include "RCSwitchReceiver.h"
+#include "RCSwitchTransmitter.h"
+#include "PulseTrain.h"
+#include "OutletCode.h"
 
 
 class RCSwitch {
@@ -62,61 +63,86 @@ class RCSwitch {
     void switchOff(char* sGroup, int nSwitchNumber);
     void switchOn(char sFamily, int nGroup, int nDevice);
     void switchOff(char sFamily, int nGroup, int nDevice);
-
-    void sendTriState(char* Code);
-    void send(unsigned long Code, unsigned int length);
+    std::shared_future<bool> switchOnAsync(int nGroupNumber, int nSwitchNumber);
+    std::shared_future<bool> switchOffAsync(int nGroupNumber, int nSwitchNumber);
+    std::shared_future<bool> switchOnAsync(char* sGroup, int nSwitchNumber);
+    std::shared_future<bool> switchOffAsync(char* sGroup, int nSwitchNumber);
+    std::shared_future<bool> switchOnAsync(char sFamily, int nGroup, int nDevice);
+    std::shared_future<bool> switchOffAsync(char sFamily, int nGroup, int nDevice);
+
+    void switchBatch(const OutletCode* codes, unsigned int nCount);
+    std::shared_future<bool> switchBatchAsync(const OutletCode* codes, unsigned int nCount);
+
+    void sendTriState(const char* Code);
+    void send(unsigned long long Code, unsigned int length);
     void send(char* Code);
+    void sendCoded(unsigned long long data, unsigned int nBits);
+    std::shared_future<bool> enqueueTriState(const char* Code);
+    std::shared_future<bool> enqueue(unsigned long long Code, unsigned int length);
+    std::shared_future<bool> enqueue(char* Code);
+    std::shared_future<bool> enqueueCoded(unsigned long long data, unsigned int nBits);
+    unsigned int getPendingTransmits();
     
     void enableReceive(int interrupt);
+    void enableReceive(EdgeSource* source);
     void enableReceive();
     void disableReceive();
     bool available();
 	void resetAvailable();
+    unsigned int drain(RCSwitchFrame* frames, unsigned int maxFrames);
+    bool waitAvailable(int nTimeout);
+    int getReceiveFd();
 	
-    unsigned long getReceivedValue();
+    unsigned long long getReceivedValue();
     unsigned int getReceivedBitlength();
     unsigned int getReceivedDelay();
 	unsigned int getReceivedProtocol();
     unsigned int* getReceivedRawdata();
+    unsigned long getDroppedEdges();
+    unsigned long getDroppedFrames();
+    unsigned long getCheckedFrames();
+    unsigned long getCorruptFrames();
+    unsigned long getCorrectedBits();
+
+    bool startCapture(const char* path);
+    void stopCapture();
   
     void enableTransmit(int nTransmitterPin);
     void disableTransmit();
     void setPulseLength(int nPulseLength);
     void setRepeatTransmit(int nRepeatTransmit);
     void setReceiveTolerance(int nPercent);
+    void setStationBits(unsigned int nBits);
+    void setCheckedBitlength(unsigned int nBits);
+    void setCodedBitlength(unsigned int nBits);
+    bool getCalibration(int nProtocol, unsigned int nStation, RCSwitchCalibration& calibration);
 	void setProtocol(int nProtocol);
 	void setProtocol(int nProtocol, int nPulseLength);
+
+    static const RCSwitchProtocol* getProtocol(int nProtocol);
+    static unsigned int getProtocolCount();
   
   private:
-    char* getCodeWordB(int nGroupNumber, int nSwitchNumber, boolean bStatus);
-    char* getCodeWordA(char* sGroup, int nSwitchNumber, boolean bStatus);
-    char* getCodeWordC(char sFamily, int nGroup, int nDevice, boolean bStatus);
-    void sendT0();
-    void sendT1();
-    void sendTF();
-    void send0();
-    void send1();
-    void sendSync();
-    void transmit(int nHighPulses, int nLowPulses);
-
-    static char* dec2binWzerofill(unsigned long dec, unsigned int length);
+    std::shared_future<bool> transmit(const PulseTrain& train);
+    void useReceiver(RCSwitchReceiver* receiver);
     
-    static void handleInterrupt();
-	static bool receiveProtocol1(unsigned int changeCount);
-	static bool receiveProtocol2(unsigned int changeCount);
     int nReceiverInterrupt;
     int nTransmitterPin;
+    // the pin's transmit queue, NULL while transmitting is disabled
+    RCSwitchTransmitter* transmitter;
     int nPulseLength;
     int nRepeatTransmit;
 	char nProtocol;
 
-	static int nReceiveTolerance;
-    static unsigned long nReceivedValue;
-    static unsigned int nReceivedBitlength;
-	static unsigned int nReceivedDelay;
-	static unsigned int nReceivedProtocol;
-    static unsigned int timings[RCSWITCH_MAX_CHANGES];
-
+    // the pin's receive state, NULL until the first enableReceive()
+    RCSwitchReceiver* receiver;
+    int nReceiveTolerance;
+    unsigned int nStationBits;
+    unsigned int nCheckedBitlength;
+    unsigned int nCodedBitlength;
+    // frame returned by the getReceived* methods until resetAvailable()
+    RCSwitchFrame receivedFrame;
+    bool bReceivedFrame;
     
 };
 
@@ -0,0 +1,589 @@
+/*
+  RCSwitchDecoder - the receive half of RCSwitch, see RCSwitchDecoder.h.
+
+  Split out of RCSwitch.cpp (rc-switch, Copyright (c) 2011 Suat Özgür,
+  GNU Lesser General Public License 2.1 or later).
+*/
+
+#include "RCSwitchDecoder.h"
+#include "PulseClassifier.h"
+#include <time.h>
+#include <stddef.h>
+#include <string.h>
+#include <poll.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+/**
+ * Known protocols, protocol N is entry N-1. The decoders below are instantiated
+ * from this table so all the pulse ratios are compile time constants.
+ *
+ * To add a protocol: append its waveform here and its decoder to protocolDecoders.
+ */
+static constexpr RCSwitchProtocol protocols[] = {
+  { 350, {  1, 31 }, {  1,  3 }, {  3,  1 }, false },    // 1
+  { 650, {  1, 10 }, {  1,  2 }, {  2,  1 }, false },    // 2
+};
+
+static constexpr unsigned int protocolCount = sizeof(protocols) / sizeof(protocols[0]);
+static_assert(protocolCount <= RCSWITCH_MAX_PROTOCOLS, "raise RCSWITCH_MAX_PROTOCOLS");
+static_assert(RCSWITCH_MAX_BITS >= 4 && RCSWITCH_MAX_BITS <= 64, "frames are 4..64 bits");
+
+RCSwitchDecoder::RCSwitchDecoder() : nDroppedFrames(0), nFrameFd(-1), nCheckedFrames(0), nCorruptFrames(0), nCorrectedBits(0) {
+  this->nReceiveTolerance = 60;
+  this->nCheckedBitlength = 0;
+  this->nCodedBitlength = 0;
+  this->nChangeCount = 0;
+  this->nStationBits = 0;
+  this->nVoteProtocol = 0;
+  this->nVoteBits = 0;
+  this->nVoteDelay = 0;
+  this->nVoteRepeats = 0;
+  this->bVotePublished = false;
+  this->nVotePublished = 0;
+  for (unsigned int i = 0; i < RCSWITCH_MAX_CHANGES; i++) {
+    this->timings[i] = 0;
+  }
+  for (unsigned int p = 0; p < RCSWITCH_MAX_PROTOCOLS; p++) {
+    for (unsigned int n = 0; n < (1 << RCSWITCH_MAX_STATION_BITS); n++) {
+      this->calibrations[p][n] = NULL;
+    }
+  }
+}
+
+RCSwitchDecoder::~RCSwitchDecoder() {
+  for (unsigned int p = 0; p < RCSWITCH_MAX_PROTOCOLS; p++) {
+    for (unsigned int n = 0; n < (1 << RCSWITCH_MAX_STATION_BITS); n++) {
+      delete this->calibrations[p][n];
+    }
+  }
+  if (this->nFrameFd.load() >= 0) {
+    close(this->nFrameFd.load());
+  }
+}
+
+/**
+ * Set Receiving Tolerance
+ */
+void RCSwitchDecoder::setReceiveTolerance(int nPercent) {
+  this->nReceiveTolerance = nPercent;
+}
+
+/**
+ * Turns on per station pulse calibration (see PulseCalibration.h): the first
+ * nBits bits of every frame are the station code (the first data bits of a
+ * coded frame, see setCodedBitlength), each station gets acceptance windows
+ * learned from its own frames. 0 (the default) turns it off.
+ *
+ * @param nBits  Station code bits, at most RCSWITCH_MAX_STATION_BITS
+ */
+void RCSwitchDecoder::setStationBits(unsigned int nBits) {
+  this->nStationBits = nBits > RCSWITCH_MAX_STATION_BITS ? RCSWITCH_MAX_STATION_BITS : nBits;
+}
+
+/**
+ * Frames of nBits bits end in a CRC of the bits before it (see FrameCheck.h):
+ * those that do not match are dropped before they are queued, the others are
+ * queued without the CRC and marked checked. Frames of other lengths are
+ * queued as before. 0 (the default) checks nothing.
+ *
+ * @param nBits  Length of a checked frame, CRC included (after the error
+ *               correction, if the frames are coded)
+ */
+void RCSwitchDecoder::setCheckedBitlength(unsigned int nBits) {
+  this->nCheckedBitlength = nBits > FRAME_CHECK_BITS ? nBits : 0;
+}
+
+/**
+ * Frames of nBits bits are Hamming codes (see HammingCode.h): a wrong bit is
+ * corrected, and a repeat with up to two unreadable bits is filled in on its
+ * own, without waiting for the majority vote. Frames that can not be corrected
+ * are dropped; the others are queued as their data bits. 0 (the default) turns
+ * it off.
+ *
+ * @param nBits  Length of a coded frame, e.g. HammingCode::codedBits(40)
+ */
+void RCSwitchDecoder::setCodedBitlength(unsigned int nBits) {
+  this->nCodedBitlength = HammingCode::dataBits(nBits) > 0 ? nBits : 0;
+}
+
+/**
+ * What was learned so far about a station.
+ *
+ * @param nProtocol      Protocol the station sends with
+ * @param nStation       Station code
+ * @param calibration    Receives the learned windows
+ *
+ * @return false if nothing was received from that station yet
+ */
+bool RCSwitchDecoder::getCalibration(int nProtocol, unsigned int nStation, RCSwitchCalibration& calibration) {
+  if (nProtocol < 1 || nProtocol > (int)protocolCount || nStation >= (1 << RCSWITCH_MAX_STATION_BITS)) {
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(this->calibrationMutex);
+  PulseCalibration* station = this->calibrations[nProtocol - 1][nStation];
+  if (station == NULL) {
+    return false;
+  }
+  calibration = station->getCalibration();
+  return true;
+}
+
+/**
+  * Returns the waveform description of protocol nProtocol (1..getProtocolCount()), NULL if unknown.
+  */
+const RCSwitchProtocol* RCSwitchDecoder::getProtocol(int nProtocol) {
+  if (nProtocol < 1 || nProtocol > (int)protocolCount) {
+    return NULL;
+  }
+  return &protocols[nProtocol - 1];
+}
+
+unsigned int RCSwitchDecoder::getProtocolCount() {
+  return protocolCount;
+}
+
+/**
+ * Takes the oldest decoded frame off the queue.
+ *
+ * @return false if no frame is pending
+ */
+bool RCSwitchDecoder::popFrame(RCSwitchFrame& frame) {
+  return this->frames.pop(frame);
+}
+
+/**
+ * Copies all pending decoded frames, oldest first, and removes them from the queue.
+ *
+ * @param frames     Where to store the frames
+ * @param maxFrames  Capacity of frames; RCSWITCH_FRAME_BUFFER always gets everything
+ *
+ * @return number of frames stored
+ */
+unsigned int RCSwitchDecoder::drain(RCSwitchFrame* frames, unsigned int maxFrames) {
+  unsigned int count = 0;
+  this->clearFrameFd();
+  while (count < maxFrames && this->frames.pop(frames[count])) {
+    count++;
+  }
+  return count;
+}
+
+/**
+ * Sleeps until a decoded frame is pending.
+ *
+ * @param nTimeout  Longest wait in milliseconds, -1 for no limit
+ *
+ * @return false if the time ran out with the queue still empty
+ */
+bool RCSwitchDecoder::waitFrames(int nTimeout) {
+  struct pollfd event;
+  event.fd = this->getFrameFd();
+  event.events = POLLIN;
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  int remaining = nTimeout;
+
+  // the fd is cleared before the queue is looked at: a frame queued after that signals it again
+  this->clearFrameFd();
+  while (this->frames.empty()) {
+    // without an eventfd, look at the queue every 10ms
+    int wait = event.fd >= 0 || (remaining >= 0 && remaining < 10) ? remaining : 10;
+    if (poll(&event, event.fd >= 0 ? 1 : 0, wait) < 0 && errno != EINTR) {
+      return false;
+    }
+    this->clearFrameFd();
+    if (nTimeout >= 0) {
+      struct timespec now;
+      clock_gettime(CLOCK_MONOTONIC, &now);
+      remaining = nTimeout - (int)((now.tv_sec - start.tv_sec) * 1000 + (now.tv_nsec - start.tv_nsec) / 1000000);
+      if (remaining <= 0) {
+        return !this->frames.empty();
+      }
+    }
+  }
+  return true;
+}
+
+/**
+ * An eventfd that becomes readable when a frame is queued, for a reader that
+ * waits on other descriptors too (a socket, a timer). drain() clears it: when
+ * it polls readable, drain until fewer than maxFrames come back.
+ *
+ * @return -1 if the kernel has no eventfd for us
+ */
+int RCSwitchDecoder::getFrameFd() {
+  int fd = this->nFrameFd.load(std::memory_order_acquire);
+  if (fd < 0) {
+    std::lock_guard<std::mutex> lock(this->frameFdMutex);
+    fd = this->nFrameFd.load(std::memory_order_relaxed);
+    if (fd < 0) {
+      fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+      this->nFrameFd.store(fd, std::memory_order_release);
+    }
+  }
+  return fd;
+}
+
+/**
+ * Resets the eventfd of getFrameFd() to not readable.
+ */
+void RCSwitchDecoder::clearFrameFd() {
+  int fd = this->nFrameFd.load(std::memory_order_acquire);
+  eventfd_t count;
+  if (fd >= 0) {
+    eventfd_read(fd, &count);
+  }
+}
+
+/**
+ * Number of decoded frames lost because the application did not drain the queue in time
+ */
+unsigned long RCSwitchDecoder::getDroppedFrames() {
+  return this->nDroppedFrames.load(std::memory_order_relaxed);
+}
+
+/**
+ * Number of decoded frames whose CRC matched, every repeat counted
+ */
+unsigned long RCSwitchDecoder::getCheckedFrames() {
+  return this->nCheckedFrames.load(std::memory_order_relaxed);
+}
+
+/**
+ * Number of decoded frames dropped because the CRC did not match or the error
+ * correction could not fix them, every repeat counted: with getCheckedFrames()
+ * this is the corruption rate of what got past the pulse checks
+ */
+unsigned long RCSwitchDecoder::getCorruptFrames() {
+  return this->nCorruptFrames.load(std::memory_order_relaxed);
+}
+
+/**
+ * Number of bits the error correction fixed or filled in, in the published frames
+ */
+unsigned long RCSwitchDecoder::getCorrectedBits() {
+  return this->nCorrectedBits.load(std::memory_order_relaxed);
+}
+
+/**
+ * Turns the bits of a frame as received into what the application gets:
+ * corrects a coded frame, then checks and removes the CRC.
+ *
+ * @param code    The frame; a coded one is corrected in place
+ * @param nBits   Its length
+ * @param erased  Bits that could not be read, only a coded frame can do without them
+ * @param frame   Receives value, bitlength, checked and corrected
+ *
+ * @return false if the frame is corrupt or incomplete
+ */
+bool RCSwitchDecoder::unpackFrame(unsigned long long& code, unsigned int nBits, unsigned long long erased, RCSwitchFrame& frame) {
+  frame.value = code;
+  frame.bitlength = nBits;
+  frame.checked = false;
+  frame.corrected = 0;
+
+  if (nBits == this->nCodedBitlength) {
+    int corrected = HammingCode::decode(code, nBits, erased, &frame.value);
+    if (corrected < 0) {
+      // too many unreadable bits is not corruption, the repeats may still do
+      if (erased == 0) {
+        this->nCorruptFrames.fetch_add(1, std::memory_order_relaxed);
+      }
+      return false;
+    }
+    frame.bitlength = HammingCode::dataBits(nBits);
+    frame.corrected = corrected;
+  } else if (erased != 0) {
+    return false;
+  }
+
+  if (frame.bitlength == this->nCheckedBitlength) {
+    if (!FrameCheck::verify(frame.value, frame.bitlength)) {
+      this->nCorruptFrames.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    frame.value >>= FRAME_CHECK_BITS;
+    frame.bitlength -= FRAME_CHECK_BITS;
+    frame.checked = true;
+    this->nCheckedFrames.fetch_add(1, std::memory_order_relaxed);
+  }
+  return true;
+}
+
+unsigned int* RCSwitchDecoder::getRawdata() {
+  return this->timings;
+}
+
+/**
+ * Queues a frame unpacked by unpackFrame() for the application, once per
+ * transmission: the other repeats with the same value are duplicates.
+ */
+void RCSwitchDecoder::publishReceived(RCSwitchFrame& frame, unsigned int delay, unsigned int protocol,
+                                      unsigned int repeats, bool voted) {
+  if (this->bVotePublished && frame.value == this->nVotePublished) {
+    return;
+  }
+  this->bVotePublished = true;
+  this->nVotePublished = frame.value;
+  this->nCorrectedBits.fetch_add(frame.corrected, std::memory_order_relaxed);
+
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  frame.delay = delay;
+  frame.protocol = protocol;
+  frame.receivedAt = (unsigned long long)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+  frame.repeats = repeats;
+  frame.voted = voted;
+  if (!this->frames.push(frame)) {
+    this->nDroppedFrames.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  int fd = this->nFrameFd.load(std::memory_order_acquire);
+  if (fd >= 0) {
+    eventfd_write(fd, 1);
+  }
+}
+
+/**
+ * Adds the bits of one repeat to the votes of the transmission being received.
+ * A repeat that does not fit (other protocol or length, or against the majority
+ * so far on more than a quarter of the bits) starts a new transmission.
+ * A repeat of the same protocol that is only a different length is ignored
+ * unless it decoded cleanly and is longer: a glitch or a lost edge adds or
+ * hides a pulse pair, the bits after it do not line up with the other repeats,
+ * and a lost edge merges the last bit into the sync, leaving a clean looking
+ * but shorter wrong code.
+ *
+ * @param protocol  Index into protocols
+ * @param ones      The bits read as 1, first one most significant
+ * @param valid     The bits that could be read at all
+ *
+ * @return false if the repeat was ignored
+ */
+bool RCSwitchDecoder::vote(unsigned int protocol, unsigned int nBits, unsigned int delay,
+                           unsigned long long ones, unsigned long long valid) {
+  if (this->nVoteRepeats > 0) {
+    if (protocol == this->nVoteProtocol && nBits != this->nVoteBits
+        && (nBits < this->nVoteBits || valid != (nBits < 64 ? (1ULL << nBits) - 1 : ~0ULL))) {
+      return false;
+    }
+    bool same = protocol == this->nVoteProtocol && nBits == this->nVoteBits;
+    unsigned int compared = 0, against = 0;
+    for (unsigned int b = 0; same && b < nBits; b++) {
+      unsigned long long mask = 1ULL << (nBits - 1 - b);
+      if ((valid & mask) && 2 * this->voteOnes[b] != this->voteCount[b]) {
+        compared++;
+        against += ((ones & mask) != 0) != (2 * this->voteOnes[b] > this->voteCount[b]);
+      }
+    }
+    if (!same || 4 * against > compared) {
+      this->finishVote();
+    }
+  }
+
+  if (this->nVoteRepeats == 0) {
+    this->nVoteProtocol = protocol;
+    this->nVoteBits = nBits;
+    this->bVotePublished = false;
+    memset(this->voteCount, 0, sizeof(this->voteCount));
+    memset(this->voteOnes, 0, sizeof(this->voteOnes));
+  }
+  this->nVoteDelay = delay;
+  if (this->nVoteRepeats < 255) {
+    this->nVoteRepeats++;
+    for (unsigned int b = 0; b < nBits; b++) {
+      unsigned long long mask = 1ULL << (nBits - 1 - b);
+      this->voteCount[b] += (valid & mask) != 0;
+      this->voteOnes[b] += (valid & ones & mask) != 0;
+    }
+  }
+  return true;
+}
+
+/**
+ * Fewest repeats that agree with code on any one of its bits.
+ */
+unsigned int RCSwitchDecoder::agreement(unsigned long long code) {
+  unsigned int repeats = this->nVoteRepeats;
+  for (unsigned int b = 0; b < this->nVoteBits; b++) {
+    bool one = (code >> (this->nVoteBits - 1 - b)) & 1;
+    unsigned int agree = one ? this->voteOnes[b] : this->voteCount[b] - this->voteOnes[b];
+    if (agree < repeats) {
+      repeats = agree;
+    }
+  }
+  return repeats;
+}
+
+/**
+ * The transmission is over. If none of its repeats decoded cleanly, rebuilds
+ * it bit by bit from the majority of the repeats that could read each bit;
+ * a bit nobody could read, a tie, or a majority of one loses the frame.
+ */
+void RCSwitchDecoder::finishVote() {
+  if (this->nVoteRepeats >= RCSWITCH_MIN_VOTES && !this->bVotePublished && this->nVoteBits > 3) {
+    unsigned long long code = 0;
+    bool decided = true;
+    for (unsigned int b = 0; b < this->nVoteBits; b++) {
+      if (this->voteCount[b] == 0 || 2 * this->voteOnes[b] == this->voteCount[b]) {
+        decided = false;
+        break;
+      }
+      code = (code << 1) | (2 * this->voteOnes[b] > this->voteCount[b]);
+    }
+    unsigned int repeats = decided ? this->agreement(code) : 0;
+    RCSwitchFrame frame;
+    if (decided && repeats >= 2 && code != 0 && this->unpackFrame(code, this->nVoteBits, 0, frame)) {
+      this->publishReceived(frame, this->nVoteDelay, this->nVoteProtocol + 1, repeats, true);
+    }
+  }
+  this->nVoteRepeats = 0;
+}
+
+/**
+ * Decodes the buffered timings as protocol P (index into protocols).
+ *
+ * timings[0] is the long part of the sync, then come the pulse pairs,
+ * one pair per bit, in the order they were sent.
+ */
+template <unsigned int P>
+bool RCSwitchDecoder::receiveProtocol(unsigned int changeCount) {
+
+    constexpr unsigned int syncLength = protocols[P].sync.low > protocols[P].sync.high ? protocols[P].sync.low : protocols[P].sync.high;
+    constexpr unsigned int zeroFirst = protocols[P].zero.high;
+    constexpr unsigned int zeroSecond = protocols[P].zero.low;
+    constexpr unsigned int oneFirst = protocols[P].one.high;
+    constexpr unsigned int oneSecond = protocols[P].one.low;
+    // an inverted sync ends on the short part, which is measured before the first data bit
+    constexpr unsigned int firstDataTiming = protocols[P].inverted ? 2 : 1;
+
+    unsigned int delay = this->timings[0] / syncLength;
+    unsigned int nBits = (changeCount - firstDataTiming) / 2;
+    const unsigned int* data = this->timings + firstDataTiming;
+    PulseWindows windows = pulseWindows(delay, this->nReceiveTolerance, zeroFirst, zeroSecond, oneFirst, oneSecond);
+    PulseCalibration* station = NULL;
+    unsigned long long bits = 0;
+
+    // the station code decides which windows the rest of the frame is held to;
+    // in a coded frame it is the first data bits, with parity bits in between
+    const bool coded = nBits == this->nCodedBitlength;
+    const unsigned int nLeadingBits = coded ? HammingCode::leadingBits(this->nStationBits) : this->nStationBits;
+    if (this->nStationBits > 0 && nBits > nLeadingBits
+        && classifyPulses(data, nLeadingBits, windows, &bits)) {
+      station = this->calibrations[P][coded ? HammingCode::extractLeading(bits, nLeadingBits) : bits];
+      if (station != NULL && station->isReady()) {
+        PulseWindows learned = station->getWindows(delay);
+        // never accept more than the fixed tolerance would
+        windows.zeroFirst = intersectWindow(windows.zeroFirst, learned.zeroFirst);
+        windows.zeroSecond = intersectWindow(windows.zeroSecond, learned.zeroSecond);
+        windows.oneFirst = intersectWindow(windows.oneFirst, learned.oneFirst);
+        windows.oneSecond = intersectWindow(windows.oneSecond, learned.oneSecond);
+      }
+    }
+
+    const unsigned long long allBits = nBits < 64 ? (1ULL << nBits) - 1 : ~0ULL;
+    RCSwitchFrame frame;
+    if (!classifyPulses(data, nBits, windows, &bits)) {
+      // keep the bits that could be read for the majority vote over the repeats
+      unsigned long long ones, valid;
+      classifyPulseBits(data, nBits, windows, &ones, &valid);
+      // a coded frame may do with this repeat alone
+      if (this->vote(P, nBits, delay, ones, valid) && changeCount > 6
+          && this->unpackFrame(ones, nBits, ~valid & allBits, frame)) {
+        this->publishReceived(frame, delay, P + 1, this->agreement(ones), false);
+      }
+      return false;
+    }
+    unsigned long long code = bits;
+    if (!this->vote(P, nBits, delay, bits, allBits)) {
+      return false;
+    }
+
+    // a frame that is corrupt (or needed correcting) teaches nothing and a corrupt one
+    // is not published, but it was voted on: its repeats may still rebuild the right value
+    bool intact = code != 0 && this->unpackFrame(code, nBits, 0, frame);
+    // learnt under the station of the decoded value, not of the bits on air (parity bits, with FEC)
+    if (this->nStationBits > 0 && intact && frame.corrected == 0 && frame.bitlength > this->nStationBits) {
+      std::lock_guard<std::mutex> lock(this->calibrationMutex);
+      PulseCalibration*& learning = this->calibrations[P][frame.value >> (frame.bitlength - this->nStationBits)];
+      if (learning == NULL) {
+        learning = new PulseCalibration();
+      }
+      learning->add(data, nBits, bits, delay);
+    }
+    // ignore < 4bit values as there are no devices sending 4bit values => noise
+    if (changeCount > 6 && intact) {
+      this->publishReceived(frame, delay, P + 1, this->agreement(code), false);
+    }
+
+	return code != 0;
+}
+
+// one decoder per entry of protocols, in the same order
+const RCSwitchDecoder::ProtocolDecoder RCSwitchDecoder::protocolDecoders[] = {
+  &RCSwitchDecoder::receiveProtocol<0>,
+  &RCSwitchDecoder::receiveProtocol<1>,
+};
+
+/**
+ * Picks the protocol whose sync/bit length ratio is closest to the one in the
+ * buffered timings: a data bit (high + low) is the same length for "0" and "1",
+ * so timings[0] / (timings[1] + timings[2]) identifies the protocol without
+ * decoding the frame.
+ *
+ * @return index into protocols
+ */
+unsigned int RCSwitchDecoder::detectProtocol() {
+  static_assert(sizeof(protocolDecoders) / sizeof(protocolDecoders[0]) == protocolCount, "every protocol needs a decoder");
+
+  unsigned long long sync = this->timings[0];
+  unsigned long long bit = this->timings[1] + this->timings[2];
+  unsigned int best = 0;
+  unsigned long long bestError = 0, bestScale = 1;
+
+  for (unsigned int p = 0; p < protocolCount; p++) {
+    unsigned long long syncLength = protocols[p].sync.low > protocols[p].sync.high ? protocols[p].sync.low : protocols[p].sync.high;
+    unsigned long long bitLength = protocols[p].zero.high + protocols[p].zero.low;
+    // relative error of sync/bit against syncLength/bitLength, compared as error/scale fractions
+    unsigned long long measured = sync * bitLength;
+    unsigned long long expected = bit * syncLength;
+    unsigned long long error = measured > expected ? measured - expected : expected - measured;
+    if (p == 0 || error * bestScale < bestError * expected) {
+      best = p;
+      bestError = error;
+      bestScale = expected;
+    }
+  }
+  return best;
+}
+
+/**
+ * Takes the duration of one signal level, in microseconds.
+ *
+ * Every frame between two syncs of the same length is decoded: the repeats of
+ * a transmission are voted on (see finishVote()) until a long gap that is not
+ * that sync, or a run of noise too long to be a frame, ends it.
+ */
+void RCSwitchDecoder::handleDuration(unsigned int duration) {
+
+  if (duration > 5000 && duration > this->timings[0] - 200 && duration < this->timings[0] + 200) {
+    // drop the high part of this sync, the rest since the previous sync is a frame
+    this->nChangeCount--;
+    if (this->nChangeCount > 2) {
+      (this->*protocolDecoders[this->detectProtocol()])(this->nChangeCount);
+    }
+    this->nChangeCount = 0;
+  } else if (duration > 5000) {
+    this->finishVote();
+    this->nChangeCount = 0;
+  }
+
+  if (this->nChangeCount >= RCSWITCH_MAX_CHANGES) {
+    this->finishVote();
+    this->nChangeCount = 0;
+  }
+  this->timings[this->nChangeCount++] = duration;
+}
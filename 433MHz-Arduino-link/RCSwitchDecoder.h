@@ -0,0 +1,160 @@
+/*
+  RCSwitchDecoder - the receive half of RCSwitch without any hardware access.
+
+  Feed it the duration of every signal level (time between two edges) and it
+  finds the sync pulses, decodes the frame in between with the matching
+  protocol and queues the result. RCSwitch feeds it from the interrupt edges;
+  RCReplay feeds it from a capture file, so the decoder can be run and
+  measured on any Linux box, without wiringPi or a radio.
+
+  handleDuration() and the frame queue readers may run on different threads
+  (one each). The reader can sleep until a frame is queued: waitFrames(), or
+  getFrameFd() in its own poll() set.
+*/
+#ifndef _RCSwitchDecoder_h
+#define _RCSwitchDecoder_h
+
+#include <atomic>
+#include <mutex>
+#include "RingBuffer.h"
+#include "PulseCalibration.h"
+#include "FrameCheck.h"
+#include "HammingCode.h"
+
+// Longest frame: up to 64 bits (RCSwitchFrame::value). A smaller value shrinks the
+// timings buffer and makes a run of noise end sooner.
+#ifndef RCSWITCH_MAX_BITS
+#define RCSWITCH_MAX_BITS 64
+#endif
+
+// Number of maximum High/Low changes per packet.
+// 2 H/L changes per bit + 3 for the sync (an inverted one is measured before and after the frame)
+#define RCSWITCH_MAX_CHANGES (RCSWITCH_MAX_BITS * 2 + 3)
+
+// Number of decoded frames kept until the application drains them (must be a power of two)
+#define RCSWITCH_FRAME_BUFFER 64
+
+// Size of the protocol table the per station calibration is kept for
+#define RCSWITCH_MAX_PROTOCOLS 8
+
+// Station codes with their own calibration: up to 4 station bits
+#define RCSWITCH_MAX_STATION_BITS 4
+
+// Repeats of a transmission needed to rebuild it by majority vote when none decoded cleanly
+#define RCSWITCH_MIN_VOTES 3
+
+/**
+ * High and low time of one waveform element, in pulse lengths.
+ */
+struct RCSwitchPulses {
+    unsigned char high;
+    unsigned char low;
+};
+
+/**
+ * Description of one protocol: the waveform of the sync, of a "0" and of a "1" bit.
+ * An inverted protocol sends low first, then high.
+ */
+struct RCSwitchProtocol {
+    unsigned int pulseLength;   // default pulse length in microseconds
+    RCSwitchPulses sync;
+    RCSwitchPulses zero;
+    RCSwitchPulses one;
+    bool inverted;
+};
+
+/**
+ * One decoded transmission.
+ */
+struct RCSwitchFrame {
+    unsigned long long value;           // the bits, first one most significant
+    unsigned int bitlength;             // number of bits in value, 4..RCSWITCH_MAX_BITS
+    unsigned int delay;                 // pulse length in microseconds
+    unsigned int protocol;
+    unsigned long long receivedAt;      // CLOCK_MONOTONIC, in microseconds
+    unsigned int repeats;               // fewest repeats of the transmission that agreed on any one bit of value
+    bool voted;                         // no repeat decoded cleanly, value is the per bit majority
+    bool checked;                       // the frame ended in a matching CRC, value and bitlength are without it
+    unsigned int corrected;             // bits the error correction fixed or filled in, see HammingCode.h
+};
+
+
+class RCSwitchDecoder {
+
+  public:
+    RCSwitchDecoder();
+    ~RCSwitchDecoder();
+
+    void handleDuration(unsigned int duration);
+
+    bool popFrame(RCSwitchFrame& frame);
+    unsigned int drain(RCSwitchFrame* frames, unsigned int maxFrames);
+    bool waitFrames(int nTimeout);
+    int getFrameFd();
+    void clearFrameFd();
+    unsigned long getDroppedFrames();
+    unsigned long getCheckedFrames();
+    unsigned long getCorruptFrames();
+    unsigned long getCorrectedBits();
+    unsigned int* getRawdata();
+
+    void setReceiveTolerance(int nPercent);
+    void setStationBits(unsigned int nBits);
+    void setCheckedBitlength(unsigned int nBits);
+    void setCodedBitlength(unsigned int nBits);
+    bool getCalibration(int nProtocol, unsigned int nStation, RCSwitchCalibration& calibration);
+
+    static const RCSwitchProtocol* getProtocol(int nProtocol);
+    static unsigned int getProtocolCount();
+
+  private:
+    unsigned int detectProtocol();
+    template <unsigned int P> bool receiveProtocol(unsigned int changeCount);
+    typedef bool (RCSwitchDecoder::*ProtocolDecoder)(unsigned int changeCount);
+    static const ProtocolDecoder protocolDecoders[];
+    bool vote(unsigned int protocol, unsigned int nBits, unsigned int delay, unsigned long long ones, unsigned long long valid);
+    void finishVote();
+    unsigned int agreement(unsigned long long code);
+    bool unpackFrame(unsigned long long& code, unsigned int nBits, unsigned long long erased, RCSwitchFrame& frame);
+    void publishReceived(RCSwitchFrame& frame, unsigned int delay, unsigned int protocol, unsigned int repeats, bool voted);
+
+    int nReceiveTolerance;
+    // the first nStationBits bits of a frame (data bits, if coded) identify the sender, 0 turns calibration off
+    unsigned int nStationBits;
+    // frames of this length end in a CRC (see FrameCheck.h), 0 if none do
+    unsigned int nCheckedBitlength;
+    // frames of this length are Hamming codes (see HammingCode.h), 0 if none are;
+    // the CRC, if any, is inside the data they carry
+    unsigned int nCodedBitlength;
+    // created on the first frame of each station; updated on the decoding thread under the mutex
+    PulseCalibration* calibrations[RCSWITCH_MAX_PROTOCOLS][1 << RCSWITCH_MAX_STATION_BITS];
+    std::mutex calibrationMutex;
+    unsigned int timings[RCSWITCH_MAX_CHANGES];
+    unsigned int nChangeCount;
+
+    // the repeats of the transmission being received: how often each bit
+    // (first one at index 0) was classified at all and as a 1
+    unsigned int nVoteProtocol;
+    unsigned int nVoteBits;
+    unsigned int nVoteDelay;
+    unsigned int nVoteRepeats;
+    unsigned char voteCount[RCSWITCH_MAX_BITS];
+    unsigned char voteOnes[RCSWITCH_MAX_BITS];
+    // a repeat decoded (cleanly, or corrected) and its value was published: the others are duplicates
+    bool bVotePublished;
+    unsigned long long nVotePublished;
+
+    // decoded frames, from the thread calling handleDuration() to the application
+    RingBuffer<RCSwitchFrame, RCSWITCH_FRAME_BUFFER> frames;
+    std::atomic<unsigned long> nDroppedFrames;
+    // eventfd signalled for every queued frame, -1 until a reader asks for it:
+    // a decoder nobody waits on (RCReplay, RCBench) makes no system calls
+    std::atomic<int> nFrameFd;
+    std::mutex frameFdMutex;
+    // decoded frames that passed and failed the CRC, or could not be corrected
+    std::atomic<unsigned long> nCheckedFrames;
+    std::atomic<unsigned long> nCorruptFrames;
+    std::atomic<unsigned long> nCorrectedBits;
+};
+
+#endif
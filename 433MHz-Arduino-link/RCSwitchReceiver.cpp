@@ -0,0 +1,135 @@
+/*
+  RCSwitchReceiver - everything that receives from one edge source, see RCSwitchReceiver.h
+*/
+
+#include "RCSwitchReceiver.h"
+#include <stdio.h>
+#include <pthread.h>
+#include <thread>
+
+std::mutex RCSwitchReceiver::registryMutex;
+RCSwitchReceiver* RCSwitchReceiver::receivers[RCSWITCH_MAX_PINS];
+
+/**
+ * Returns the receiver of a pin, creating it on first use with the best
+ * source for the pin (see EdgeSource::forPin).
+ *
+ * @param nPin  wiringPi pin number
+ *
+ * @return NULL if the pin is out of 0..RCSWITCH_MAX_PINS-1
+ */
+RCSwitchReceiver* RCSwitchReceiver::get(int nPin) {
+  if (nPin < 0 || nPin >= RCSWITCH_MAX_PINS) {
+    return NULL;
+  }
+  std::lock_guard<std::mutex> lock(RCSwitchReceiver::registryMutex);
+  if (RCSwitchReceiver::receivers[nPin] == NULL) {
+    RCSwitchReceiver::receivers[nPin] = new RCSwitchReceiver(EdgeSource::forPin(nPin));
+  }
+  return RCSwitchReceiver::receivers[nPin];
+}
+
+/**
+ * A receiver for any source, e.g. a FileEdgeSource. It takes the source over.
+ */
+RCSwitchReceiver* RCSwitchReceiver::create(EdgeSource* source) {
+  return source != NULL ? new RCSwitchReceiver(source) : NULL;
+}
+
+RCSwitchReceiver::RCSwitchReceiver(EdgeSource* source) : bEnabled(false) {
+  this->source = source;
+}
+
+/**
+ * Starts receiving. The source and the decoder thread are started on the
+ * first call and then stay for the life of the process.
+ */
+void RCSwitchReceiver::enable() {
+  std::call_once(this->started, &RCSwitchReceiver::start, this);
+  this->bEnabled.store(true, std::memory_order_release);
+}
+
+void RCSwitchReceiver::start() {
+  if (!this->source->start()) {
+    fprintf(stderr, "RCSwitch: can not receive on pin %d\n", this->source->getPin());
+    return;
+  }
+  std::thread decoderThread(&RCSwitchReceiver::decodeEdges, this);
+  char name[16];
+  snprintf(name, sizeof(name), "rcswitch-%d", this->source->getPin());
+  pthread_setname_np(decoderThread.native_handle(), name);
+  decoderThread.detach();
+}
+
+/**
+ * Ignores the edges of the source until enable() is called again.
+ */
+void RCSwitchReceiver::disable() {
+  this->bEnabled.store(false, std::memory_order_release);
+}
+
+bool RCSwitchReceiver::isEnabled() {
+  return this->bEnabled.load(std::memory_order_acquire);
+}
+
+RCSwitchDecoder& RCSwitchReceiver::getDecoder() {
+  return this->decoder;
+}
+
+int RCSwitchReceiver::getPin() {
+  return this->source->getPin();
+}
+
+/**
+ * EDGE_CLOCK_* the edges are timestamped with: EDGE_CLOCK_KERNEL means the pulse
+ * widths carry no scheduling jitter and a tighter receive tolerance can be used.
+ */
+int RCSwitchReceiver::getClockSource() {
+  return this->source->getClockSource();
+}
+
+/**
+ * Number of edges lost before the decoder thread got them
+ */
+unsigned long RCSwitchReceiver::getDroppedEdges() {
+  return this->source->getDroppedEdges();
+}
+
+/**
+ * Records every edge the source delivers to a capture file (see EdgeCapture.h) until stopCapture().
+ *
+ * @param path  File to write
+ *
+ * @return false if the file can not be created
+ */
+bool RCSwitchReceiver::startCapture(const char* path) {
+  std::lock_guard<std::mutex> lock(this->captureMutex);
+  return this->capture.open(path, this->source->getPin(), this->source->getClockSource());
+}
+
+void RCSwitchReceiver::stopCapture() {
+  std::lock_guard<std::mutex> lock(this->captureMutex);
+  this->capture.close();
+}
+
+/**
+ * Decoder thread: turns the edges of the source into pulse durations, until the source ends.
+ */
+void RCSwitchReceiver::decodeEdges() {
+  RCSwitchEdge edges[RCSWITCH_EDGE_BATCH];
+  unsigned long lastTime = 0;
+  int count;
+
+  while ((count = this->source->read(edges, RCSWITCH_EDGE_BATCH)) >= 0) {
+    if (count == 0 || !this->isEnabled()) {
+      continue;
+    }
+    std::lock_guard<std::mutex> lock(this->captureMutex);
+    for (int i = 0; i < count; i++) {
+      this->capture.writeEdge(edges[i]);
+      this->decoder.handleDuration(edges[i].time - lastTime);
+      lastTime = edges[i].time;
+    }
+    this->capture.flush();
+  }
+}
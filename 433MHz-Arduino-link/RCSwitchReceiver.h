@@ -0,0 +1,66 @@
+/*
+  RCSwitchReceiver - everything that receives from one edge source.
+
+  A receiver takes the edges of its EdgeSource (a GPIO pin, or a capture file
+  or pipe, see EdgeSource.h) on its own decoder thread and feeds them to its
+  own decoder and frame queue. Several radios are decoded in parallel by one
+  process, with frame timestamps on the same clock.
+
+  get() returns the receiver of a pin, created on its first use; create() makes
+  one for any other source. Receivers live as long as the process, like the
+  interrupt handlers and threads that feed them. Read each receiver's frames
+  through one RCSwitch instance only: the frame queue has a single reader.
+*/
+#ifndef _RCSwitchReceiver_h
+#define _RCSwitchReceiver_h
+
+#include <atomic>
+#include <mutex>
+#include "RCSwitchDecoder.h"
+#include "EdgeCapture.h"
+#include "EdgeSource.h"
+
+// edges taken from the source per read
+#define RCSWITCH_EDGE_BATCH 64
+
+
+class RCSwitchReceiver {
+
+  public:
+    static RCSwitchReceiver* get(int nPin);
+    static RCSwitchReceiver* create(EdgeSource* source);
+
+    void enable();
+    void disable();
+    bool isEnabled();
+
+    RCSwitchDecoder& getDecoder();
+    int getPin();
+    int getClockSource();
+    unsigned long getDroppedEdges();
+
+    bool startCapture(const char* path);
+    void stopCapture();
+
+  private:
+    RCSwitchReceiver(EdgeSource* source);
+
+    void start();
+    void decodeEdges();
+
+    EdgeSource* source;
+    RCSwitchDecoder decoder;
+
+    // edges are ignored while disabled, e.g. while the same process transmits
+    std::atomic<bool> bEnabled;
+    std::once_flag started;
+
+    // raw edge recording, written by the decoder thread
+    std::mutex captureMutex;
+    EdgeCaptureWriter capture;
+
+    static std::mutex registryMutex;
+    static RCSwitchReceiver* receivers[RCSWITCH_MAX_PINS];
+};
+
+#endif
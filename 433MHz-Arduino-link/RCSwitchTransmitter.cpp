@@ -0,0 +1,175 @@
+/*
+  RCSwitchTransmitter - the transmit queue of one GPIO pin, see RCSwitchTransmitter.h
+*/
+
+#include "RCSwitchTransmitter.h"
+#include <wiringPi.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <thread>
+
+std::mutex RCSwitchTransmitter::registryMutex;
+RCSwitchTransmitter* RCSwitchTransmitter::transmitters[RCSWITCH_MAX_PINS];
+
+/**
+ * Returns the transmitter of a pin, creating it (and its thread) on first use.
+ *
+ * @param nPin  wiringPi pin number
+ *
+ * @return NULL if the pin is out of 0..RCSWITCH_MAX_PINS-1
+ */
+RCSwitchTransmitter* RCSwitchTransmitter::get(int nPin) {
+  if (nPin < 0 || nPin >= RCSWITCH_MAX_PINS) {
+    return NULL;
+  }
+  std::lock_guard<std::mutex> lock(RCSwitchTransmitter::registryMutex);
+  if (RCSwitchTransmitter::transmitters[nPin] == NULL) {
+    RCSwitchTransmitter* transmitter = new RCSwitchTransmitter(nPin);
+    std::thread senderThread(&RCSwitchTransmitter::sendBursts, transmitter);
+    char name[16];
+    snprintf(name, sizeof(name), "rcsend-%d", nPin);
+    pthread_setname_np(senderThread.native_handle(), name);
+    senderThread.detach();
+    RCSwitchTransmitter::transmitters[nPin] = transmitter;
+  }
+  return RCSwitchTransmitter::transmitters[nPin];
+}
+
+RCSwitchTransmitter::RCSwitchTransmitter(int nPin) {
+  this->nPin = nPin;
+  this->nRefused = 0;
+}
+
+/**
+ * A result that is already false, for bursts that can not be queued
+ */
+std::shared_future<bool> RCSwitchTransmitter::refused() {
+  std::promise<bool> refused;
+  refused.set_value(false);
+  return refused.get_future().share();
+}
+
+/**
+ * Queues a burst without waiting for it.
+ *
+ * @param train       The frame to send
+ * @param nRepeats    How often to send it
+ * @param receiver    Receiver to suspend while on air, NULL for none
+ *
+ * @return becomes true once sent; false at once if the queue is full
+ */
+std::shared_future<bool> RCSwitchTransmitter::enqueue(const PulseTrain& train, int nRepeats, RCSwitchReceiver* receiver) {
+  std::lock_guard<std::mutex> lock(this->queueMutex);
+
+  // the one at the front may already be on air: only the ones behind it can take a copy
+  for (std::deque<Burst>::iterator burst = this->bursts.begin() + (this->bursts.empty() ? 0 : 1); burst != this->bursts.end(); ++burst) {
+    if (burst->nRepeats == nRepeats && burst->receiver == receiver && burst->train == train) {
+      return burst->result;
+    }
+  }
+
+  if (this->bursts.size() >= RCSWITCH_TRANSMIT_QUEUE) {
+    this->nRefused++;
+    return RCSwitchTransmitter::refused();
+  }
+
+  this->bursts.emplace_back();
+  Burst& burst = this->bursts.back();
+  burst.train = train;
+  burst.nRepeats = nRepeats;
+  burst.receiver = receiver;
+  burst.result = burst.done.get_future().share();
+  this->queued.notify_one();
+  return burst.result;
+}
+
+/**
+ * Bursts queued or on air
+ */
+unsigned int RCSwitchTransmitter::getPending() {
+  std::lock_guard<std::mutex> lock(this->queueMutex);
+  return this->bursts.size();
+}
+
+/**
+ * Bursts refused because the queue was full
+ */
+unsigned long RCSwitchTransmitter::getRefused() {
+  std::lock_guard<std::mutex> lock(this->queueMutex);
+  return this->nRefused;
+}
+
+/**
+ * Sender thread: plays the front burst, then removes it, so enqueue() never
+ * coalesces with a burst already on air.
+ */
+void RCSwitchTransmitter::sendBursts() {
+  while (true) {
+    Burst* burst;
+    {
+      std::unique_lock<std::mutex> lock(this->queueMutex);
+      this->queued.wait(lock, [this] { return !this->bursts.empty(); });
+      // a deque keeps its elements in place when others are added at the back
+      burst = &this->bursts.front();
+    }
+    this->play(*burst);
+
+    std::promise<bool> done;
+    {
+      std::lock_guard<std::mutex> lock(this->queueMutex);
+      done = std::move(burst->done);
+      this->bursts.pop_front();
+    }
+    // after the pop: whoever wakes up sees the queue without it
+    done.set_value(true);
+  }
+}
+
+/**
+ * Busy waits for the last millisecond only: a sleeping thread can wake up
+ * hundreds of microseconds late, so only the long sync gaps sleep at all.
+ */
+static void waitUntil(unsigned int deadline) {
+  int remaining = (int)(deadline - micros());
+  if (remaining > 1500) {
+    delayMicroseconds(remaining - 1000);
+  }
+  while ((int)(deadline - micros()) > 0) {
+  }
+}
+
+/**
+ * Plays a compiled frame nRepeats times.
+ *
+ * Every edge is scheduled from the start of the burst, not from the previous
+ * edge, so the time spent in digitalWrite() and waking up does not add up into
+ * stretched pulses. The receiver is suspended once for the whole burst so we
+ * don't decode our own transmission.
+ */
+void RCSwitchTransmitter::play(const Burst& burst) {
+  if (burst.train.size() == 0) {
+    return;
+  }
+  bool disabledReceive = burst.receiver != NULL && burst.receiver->isEnabled();
+  if (disabledReceive) {
+    burst.receiver->disable();
+  }
+
+  const unsigned int* durations = burst.train.getDurations();
+  unsigned int count = burst.train.size();
+  unsigned int deadline = micros();
+  for (int nRepeat = 0; nRepeat < burst.nRepeats; nRepeat++) {
+    int level = burst.train.getFirstLevel();
+    for (unsigned int i = 0; i < count; i++) {
+      digitalWrite(this->nPin, level ? HIGH : LOW);
+      deadline += durations[i];
+      waitUntil(deadline);
+      level ^= 1;
+    }
+  }
+  digitalWrite(this->nPin, LOW);
+
+  if (disabledReceive) {
+    burst.receiver->enable();
+  }
+}
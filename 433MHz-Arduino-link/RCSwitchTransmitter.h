@@ -0,0 +1,67 @@
+/*
+  RCSwitchTransmitter - the transmit queue of one GPIO pin.
+
+  A burst takes long: 15 repeats of a 32 bit frame at 350us pulses are about
+  700ms on air. The transmitter plays compiled frames (see PulseTrain.h) on its
+  own thread, in order, so RCSwitch::enqueue*() and the *Async() methods return
+  at once with a std::shared_future<bool> that becomes true when the burst was
+  sent (false if it was refused because the queue was full). The blocking
+  send*() / switch*() methods queue the same way and wait, so bursts of both
+  kinds never overlap on the radio.
+
+  A burst identical to one still waiting (same waveform, repeats and receiver
+  to suspend) is not queued twice: the caller gets the pending burst's future.
+
+  Transmitters are created by get() on the first use of a pin and live as long
+  as the process.
+*/
+#ifndef _RCSwitchTransmitter_h
+#define _RCSwitchTransmitter_h
+
+#include <deque>
+#include <future>
+#include <mutex>
+#include <condition_variable>
+#include "PulseTrain.h"
+#include "RCSwitchReceiver.h"
+
+// Bursts waiting to be sent per pin
+#define RCSWITCH_TRANSMIT_QUEUE 16
+
+
+class RCSwitchTransmitter {
+
+  public:
+    static RCSwitchTransmitter* get(int nPin);
+
+    static std::shared_future<bool> refused();
+
+    std::shared_future<bool> enqueue(const PulseTrain& train, int nRepeats, RCSwitchReceiver* receiver);
+    unsigned int getPending();
+    unsigned long getRefused();
+
+  private:
+    RCSwitchTransmitter(int nPin);
+
+    struct Burst {
+      PulseTrain train;
+      int nRepeats;
+      RCSwitchReceiver* receiver;
+      std::promise<bool> done;
+      std::shared_future<bool> result;
+    };
+
+    void sendBursts();
+    void play(const Burst& burst);
+
+    int nPin;
+    std::mutex queueMutex;
+    std::condition_variable queued;
+    std::deque<Burst> bursts;
+    unsigned long nRefused;
+
+    static std::mutex registryMutex;
+    static RCSwitchTransmitter* transmitters[RCSWITCH_MAX_PINS];
+};
+
+#endif
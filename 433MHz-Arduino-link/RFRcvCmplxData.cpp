@@ -7,10 +7,12 @@
   - 8 bit: battery voltage in mV /50 (to get some decimals) -> need to multiply by 50
 
   Because the data is sent repeatedly, we need to make sure we don't get duplicates.
-  So we store the last value received and if we get it again in the next 30s, we
-  consider it a duplicate. The temp, humidity and voltage values are sent every few minutes
-  that's why we limit the check to 30s: if we receive the same value after 30s, we
-  consider it a new value - this is possible if none of tem, humidity or voltage changed.
+  So for each station we store the last temp/humidity/voltage value and the last motion
+  value received (see FrameDedup.h) and if the station sends it again in the next 30s, we
+  consider it a duplicate; other stations transmitting in between don't matter. The temp,
+  humidity and voltage values are sent every few minutes that's why we limit the check to
+  30s: if we receive the same value after 30s, we consider it a new value - this is
+  possible if none of tem, humidity or voltage changed.
 
   For the motion sensor, things are different: we don't check the sensor periodically,
   the Arduino code reacts using interrupts so there is no interval to use to check
@@ -18,40 +20,58 @@
   a message with motion=1; then the sensor is not triggered again until it resets (a few
   seconds); when it resets, we get a message with motion=0 so the value will be different.
   Then if the sensor is triggered again, we get motion=1 - a new value. And so on.
+  So motion values are only remembered for 5s, long enough to drop a repeated burst.
 
   RX:
   - Connect pin 1 (on the left) of the sensor to GROUND
   - Connect pin 2 of the sensor to whatever your RXPIN is: in my case PIN 4 (wiringPi)/pin 16 (header)/pin 23 (BCM)
   (see https://projects.drogon.net/raspberry-pi/wiringpi/pins/ for more infor)
   - Connect pin 3 (on the right) of the sensor to +5V.
+
+  Usage: RFRcvCmplxData [capture file]
+         RFRcvCmplxData -i <capture file or pipe>
+  With a file name, all the raw edges are also recorded there (see EdgeCapture.h)
+  so the session can be replayed with RCReplay. With -i the edges are read from
+  a capture, or a named pipe another program writes one to, instead of the radio.
 */
 
 #include "RCSwitch.h"
+#include "SensorPipeline.h"
+#include "HttpFanout.h"
+#include "SensorBackfill.h"
+#include "SensorStore.h"
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <time.h>
 #include <curl/curl.h>
-#include <sqlite3.h>
 
 #define MAXBUF 512
-void postData();
-void postSparkfun();
-void postDweet();
-void postThingspeak();
-void doPost(char buffer[]);
-void postDb(int posted);
-
-struct Data
-{
-    unsigned char stationCode, motion;
-    float temp, humid, batt;
-};
 
-RCSwitch mySwitch;
+// thingspeak takes up to TS_BATCH readings in one bulk update, posted at the latest
+// TS_BATCH_LATENCY ms after the oldest was received; 1 posts every reading on its own
+#define TS_BATCH 16
+#define TS_BATCH_LATENCY 60000
+
+// thingspeak refuses updates less than 15s apart: one request per TS_RATE_INTERVAL ms,
+// and while it waits the bulk update collects the readings (with TS_BATCH 1 only
+// the newest reading of each station is kept for it)
+#define TS_RATE_INTERVAL 15000
+
+// stored readings thingspeak did not take are posted again, TS_BATCH every
+// BACKFILL_INTERVAL ms at most when it has nothing else to post (see SensorBackfill.h)
+#define BACKFILL_INTERVAL 20000
+
+bool sparkfunUrl(const SensorRecord& record, char* buffer, size_t size);
+bool dweetUrl(const SensorRecord& record, char* buffer, size_t size);
+bool thingspeakUrl(const SensorRecord& record, char* buffer, size_t size);
+bool thingspeakAccepted(const char* response);
+unsigned int thingspeakBulk(const SensorRecord* records, unsigned int count,
+                            char* url, size_t urlSize, char* body, size_t bodySize);
+bool thingspeakBulkAccepted(const char* response);
+bool postDb(SensorRecord& record);
 
-unsigned char t1, t4, stationCode, motion = 0;
-unsigned short t2, t3 = 0;
-float temp, humid, batt = 0;
+RCSwitch mySwitch;
 
 // sparkfun phantIo constants
 char sparkfunServerUrl[] = "http://data.sparkfun.com";
@@ -67,6 +87,9 @@ char dweetPIRName[] = "Arduino2RasPi_motion";
 char thingspeakServerUrl[] = "http://api.thingspeak.com";
 char tsPrivateKeyDHT[] = "<private_key>";
 char tsPrivateKeyPIR[] = "<private_key>";
+// for the bulk updates
+char tsChannelDHT[] = "<channel_id>";
+char tsChannelPIR[] = "<channel_id>";
 char tsStationKey[] = "field1";
 char tsMotionKey[] = "field2";
 char tsHumidityKey[] = "field2";
@@ -79,26 +102,15 @@ char humidityKey[] = "humidity";
 char tempKey[] = "temp";
 char voltageKey[] = "voltage";
 
-char buffer[MAXBUF];
-
-boolean isMotion = false;
-
-CURL *curl;
-CURLcode res;
 boolean readyToSendToServer = false;
-struct Data data;
-int responseCode = 0;
 
 //time_t rawtime;
 //struct tm * timeinfo;
 //char timeBuffer[80];
 
-sqlite3 *dbConn;
-sqlite3_stmt *dbRes;
-int dbError;
-char dbBuffer[MAXBUF];
-char sqlInsertDHT[] = "INSERT INTO dht (station, temp, humidity, voltage, posted) values(%u, %.1f, %.1f, %.1f, %u)";
-char sqlInsertPIR[] = "INSERT INTO pir (station, motion, posted) values(%u, %u, %u)";
+// every reading goes in with whether it got posted, committed a group at a time (see SensorStore.h)
+SensorStore store;
+SensorBackfill *backfill = NULL;
 
 
 // test data
@@ -106,36 +118,63 @@ char sqlInsertPIR[] = "INSERT INTO pir (station, motion, posted) values(%u, %u,
 //unsigned int value = 4294967295;   //15-1023-1023-255
 //unsigned int value = 4026531841;   //15-0-0-1
 
-size_t function_pt(char *ptr, size_t size, size_t nmemb, void *stream) {
-    printf("%s\n", ptr);
-    responseCode = atoi(ptr);
-    return size * nmemb;
-}
-
 int main(int argc, char *argv[]) {
 
-    float startTime = clock();
-    dbError = sqlite3_open("sensors.db", &dbConn);
-    if (dbError) {
+    if (!store.open("sensors.db", STORE_SYNC_NORMAL, 32, 2000)) {
         puts("Can not open database");
         exit(0);
     }
 
-    curl = curl_easy_init();
-    if(curl) {
+    // before any thread starts and before the HttpFanout
+    if(curl_global_init(CURL_GLOBAL_DEFAULT) == 0) {
         readyToSendToServer = true;
-        // in case it is redirected, tell libcurl to follow redirection
-        curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
-        // write the response to a string
-        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, function_pt);
-        // TODO set a timeout so we don't block for a long time
     }
 
-    // we get lots of duplicates in the same transmission so we'll remember
-    // the last value received so we don't react twice to the same value
+    // each service gets its own queue (see SensorPipeline.h) and one thread posts to
+    // all of them at once (see HttpFanout.h), so a slow one never holds up the radio
+    // or the others; a service that falls behind skips the oldest readings. The
+    // database stores every reading after thingspeak had it, with whether it got
+    // posted, and makes thingspeak wait rather than lose one.
+    SensorSink* dbSink = SensorSink::create("db", postDb, 64, SINK_BLOCK);
+    HttpFanout http;
+    // thingspeak has a bulk endpoint: a request every few minutes instead of one per reading
+    SensorSink* thingspeakSink = TS_BATCH > 1
+        ? http.addBatchService("thingspeak", thingspeakBulk, thingspeakBulkAccepted,
+                               TS_BATCH, TS_BATCH_LATENCY, 16, SINK_DROP_OLDEST)
+        : http.addService("thingspeak", thingspeakUrl, thingspeakAccepted, 16, SINK_DROP_OLDEST);
+    thingspeakSink->setNext(dbSink);
+    http.setRateLimit(thingspeakSink, TS_RATE_INTERVAL, 1);
+    SensorSink* sinks[] = {
+        http.addService("sparkfun", sparkfunUrl, NULL, 16, SINK_DROP_OLDEST),
+        http.addService("dweet", dweetUrl, NULL, 16, SINK_DROP_OLDEST),
+        thingspeakSink
+    };
+    SensorPipeline pipeline;
+    if(!readyToSendToServer || !http.start()) {
+        // nothing would ever take the readings off the services' queues:
+        // store each one right away instead, not posted, for a later backfill
+        puts("Can not set up curl, nothing will be posted");
+        pipeline.addSink(dbSink);
+    } else {
+        backfill = new SensorBackfill(thingspeakSink, TS_BATCH, BACKFILL_INTERVAL);
+        if(!backfill->start("sensors.db")) {
+            puts("Can not post the stored readings again");
+        }
+        for (unsigned int i = 0; i < sizeof(sinks) / sizeof(sinks[0]); i++) {
+            pipeline.addSink(sinks[i]);
+        }
+    }
+
+    // we get lots of duplicates so we'll remember the last value each station
+    // sent of each kind so we don't react twice to the same value
     // however, if more than 30s passed more than likely this is a new
     // transmission so treat it as a new value so it gets posted (see if below)
-    unsigned int lastValue = 0;
+    FrameDedup& dedup = pipeline.getDedup();
+    dedup.setWindow(SENSOR_DHT, 30000);
+    dedup.setWindow(SENSOR_PIR, 5000);
+    unsigned long suppressedFrames = 0;
+    unsigned long droppedReadings = 0;
+    unsigned long postedReadings = 0;
 
      int PIN = 4;
 
@@ -143,189 +182,225 @@ int main(int argc, char *argv[]) {
        return 0;
 
      mySwitch = RCSwitch();
-     mySwitch.enableReceive(PIN);
+     if (argc > 2 && strcmp(argv[1], "-i") == 0) {
+       // decode a capture (or a pipe fed with one) instead of the radio
+       mySwitch.enableReceive(new FileEdgeSource(argv[2]));
+     } else {
+       mySwitch.enableReceive(PIN);
+       // optional: record every edge the radio sees, to replay it later with RCReplay
+       if (argc > 1 && !mySwitch.startCapture(argv[1])) {
+         fprintf(stderr, "Can not create capture file %s\n", argv[1]);
+       }
+     }
+     // the first 4 bits are the station code: learn each Arduino's pulse widths
+     mySwitch.setStationBits(4);
+     // a sketch with USE_CRC sends 40 bits: the 32 bit reading and a CRC-8 of it;
+     // the decoder drops the frames where it does not match and hands us the 32 bits
+     mySwitch.setCheckedBitlength(40);
+     // with USE_FEC as well those 40 bits come Hamming coded in 47: the decoder corrects them first
+     mySwitch.setCodedBitlength(47);
+     unsigned long corruptFrames = 0;
+
+     // several stations may transmit back to back: take every frame decoded since the last pass
+     RCSwitchFrame frames[RCSWITCH_FRAME_BUFFER];
 
      while(1) {
 
-      if (mySwitch.available()) {
+      // sleep until the decoder queues a frame; wake up now and then anyway to report the CRC failures
+      mySwitch.waitAvailable(10000);
+      unsigned int frameCount = mySwitch.drain(frames, RCSWITCH_FRAME_BUFFER);
+      for (unsigned int f = 0; f < frameCount; f++) {
 
-        unsigned int value = mySwitch.getReceivedValue();
-
-        float crtTime = clock();
+        // the sensor frames are 32 bits (after the CRC is removed), anything else (a remote, a longer frame) is not ours
+        if (frames[f].bitlength != 32) {
+          printf("\nReceived %llu / %ubit, not a sensor frame\n", frames[f].value, frames[f].bitlength);
+          continue;
+        }
+        unsigned int value = frames[f].value;
 
         if (value == 0) {
           printf("Unknown encoding");
         } else {
-          if(value == lastValue && (crtTime-startTime)/CLOCKS_PER_SEC < 30) {
-              // nothing to do, it's a duplicate that came in less than 30s
+          // decoded with the bit layout in SensorPayload.h, shared with the Arduino sketch;
+          // a new reading is queued for every service
+          SensorRecord record;
+          if(!pipeline.process(frames[f], record)) {
+              // nothing to do, it's a duplicate this station sent less than the window ago
               // printf("Duplicate value\n");
           } else {
-              //printf("%f\n", (crtTime - startTime)/CLOCKS_PER_SEC);
-              // reset the startTime
-              startTime = clock();
-
-              printf("\nReceived %u\n", value);
-              // display each simple value combined in the 32 bit uint
-              // first value takes only 4 bits so shift by 28
-              t1 = value >> 28;
-              // second value uses 10 bits: if we shift by 18 (4 first value, 10 this value),
-              // we'll end up with 14 bits but we are interested only in last 10 so 0 the others
-              t2 = value >> 18 & 0x3FF;   // 3FF = 00001111111111
-              // third value uses 10 bits: if we shift by 8 (4 first value, 10 second value, 10 this value),
-              // we'll end up with 14 bits but we are interested only in last 10 so 0 the others
-              t3 = value >> 8 & 0x3FF;   // 3FF = 00001111111111
-              // last value is the last byte, forcing a convertion from int to byte will get the value
-              t4 = value;
-              printf("raw values: %u-%i-%i-%i\n", t1, t2, t3, t4);
-
-              data.stationCode = 0;
-              data.motion = 0;
-              data.temp = 0.0;
-              data.humid = 0.0;
-              data.batt = 0.0;
-
-              // if t2 and t3 are 0, it's motion sensor data; otherwise is temp/humid/batt
-              if(t2 == 0 && t3 ==0) {
-                  isMotion = true;
-                  // real values
-                  stationCode = t1;    // numeric code 0-15
-                  motion = t4;         // 0=off,1=on
-                  printf("single values: %u-%u\n", stationCode, motion);
-                  data.stationCode = stationCode;
-                  data.motion = motion;
-                  postData();
+              SensorReading& data = record.reading;
+              printf("\nReceived %u%s\n", value, frames[f].checked ? " (CRC ok)" : "");
+              if(data.kind == SENSOR_PIR) {
+                  printf("single values: %u-%u\n", data.stationCode, data.motion);
               } else {
-                  isMotion = false;
-                  // real values
-                  stationCode = t1;    // numeric code 0-15
-                  temp = t2 / 10.0;    // F
-                  humid = t3 / 10.0;   // %
-                  batt = t4 * 50.0;    // mV
-                  printf("single values: %u-%.1f-%.1f-%.1f\n", stationCode, temp, humid, batt);
-                  data.stationCode = stationCode;
-                  data.temp = temp;
-                  data.humid = humid;
-                  data.batt = batt;
-                  postData();
+                  printf("single values: %u-%.1f-%.1f-%.1f\n", data.stationCode, data.temp, data.humid, data.batt);
               }
-
-              // store the new value as lastValue
-              lastValue = value;
           }
         }
+      }
 
-        mySwitch.resetAvailable();
+      if (mySwitch.getCorruptFrames() != corruptFrames || dedup.getSuppressed() != suppressedFrames) {
+        corruptFrames = mySwitch.getCorruptFrames();
+        suppressedFrames = dedup.getSuppressed();
+        printf("%lu frames failed the CRC, %lu passed, %lu bits corrected; duplicates dropped: %lu dht, %lu pir\n",
+               corruptFrames, mySwitch.getCheckedFrames(), mySwitch.getCorrectedBits(),
+               dedup.getSuppressed(SENSOR_DHT), dedup.getSuppressed(SENSOR_PIR));
+      }
+
+      // after every round of posts, or when a service could not keep up
+      unsigned long dropped = 0;
+      unsigned long posted = 0;
+      for (unsigned int i = 0; i < sizeof(sinks) / sizeof(sinks[0]); i++) {
+        dropped += sinks[i]->getDropped();
+        posted += sinks[i]->getDelivered() + sinks[i]->getFailed();
+      }
+      if (dropped != droppedReadings || posted != postedReadings) {
+        droppedReadings = dropped;
+        postedReadings = posted;
+        if (backfill != NULL) {
+          printf("stored readings posted again: %lu of %lu tried\n", backfill->getPosted(), backfill->getReplayed());
+        }
+        for (unsigned int i = 0; i < sizeof(sinks) / sizeof(sinks[0]); i++) {
+          HttpLatency latency;
+          http.getLatency(sinks[i], latency);
+          printf("%s: %lu posted, %lu failed, %lu skipped to keep up, %u waiting; "
+                 "%lums last, %lums average, %lums max, %lu connections for %lu requests\n", sinks[i]->getName(),
+                 sinks[i]->getDelivered(), sinks[i]->getFailed(), sinks[i]->getDropped(), sinks[i]->getPending(),
+                 latency.last, latency.average, latency.max, latency.connects, latency.requests);
+        }
       }
     }
 
     if(readyToSendToServer) {
         /* always cleanup */
-        curl_easy_cleanup(curl);
+        curl_global_cleanup();
     }
-//    sqlite3_finalize(dbRes);
-    sqlite3_close(dbConn);
+    store.close();
 
     exit(0);
 }
 
-// data doesn't get modified so pass by value
-void postData()
-{
-    // able to use the same curl because it is not dependent on a url
-    postSparkfun();
-    postDweet();
-    postThingspeak();
-}
-
-void postSparkfun() {
-    buffer[0] = '\0';
+bool sparkfunUrl(const SensorRecord& record, char* buffer, size_t size) {
+    const SensorReading& data = record.reading;
     // post to data.sparkfun.com
-    if(isMotion) {
+    if(data.kind == SENSOR_PIR) {
         // send motion sensor data
         // http://data.sparkfun.com/input/[publicKey]?private_key=[privateKey]&station=[value]&motion=[value]
-        sprintf(buffer,
+        snprintf(buffer, size,
             "%s/input/%s?private_key=%s&%s=%u&%s=%u", sparkfunServerUrl, publicKeyPIR, privateKeyPIR,
             stationKey, data.stationCode, motionKey, data.motion);
     } else {
         // send temp/humid/batt sensor data
         // http://data.sparkfun.com/input/[publicKey]?private_key=[privateKey]&station=[value]&humidity=[value]&temp=[value]&voltage=[value]
-        sprintf(buffer,
+        snprintf(buffer, size,
             "%s/input/%s?private_key=%s&%s=%u&%s=%.1f&%s=%.1f&%s=%.1f", sparkfunServerUrl, publicKeyDHT, privateKeyDHT,
             stationKey, data.stationCode, humidityKey, data.humid, tempKey, data.temp, voltageKey, data.batt);
     }
-    doPost(buffer);
+    return true;
 }
 
-void postDweet() {
-    buffer[0] = '\0';
+bool dweetUrl(const SensorRecord& record, char* buffer, size_t size) {
+    const SensorReading& data = record.reading;
     // post to dweet.io
-    if(isMotion) {
+    if(data.kind == SENSOR_PIR) {
         // send motion sensor data
         // https://dweet.io/dweet/for/my-thing-name?station=[value]&motion=[value]
-        sprintf(buffer,
+        snprintf(buffer, size,
             "%s%s?%s=%u&%s=%u", dweetServerUrl, dweetPIRName,
             stationKey, data.stationCode, motionKey, data.motion);
     } else {
         // send temp/humid/batt sensor data
         // https://dweet.io/dweet/for/my-thing-name?station=[value]&humidity=[value]&temp=[value]&voltage=[value]
-        sprintf(buffer,
+        snprintf(buffer, size,
             "%s%s?%s=%u&%s=%.1f&%s=%.1f&%s=%.1f", dweetServerUrl, dweetDHTName,
             stationKey, data.stationCode, humidityKey, data.humid, tempKey, data.temp, voltageKey, data.batt);
     }
-    doPost(buffer);
+    return true;
 }
 
-void postThingspeak() {
-    buffer[0] = '\0';
+bool thingspeakUrl(const SensorRecord& record, char* buffer, size_t size) {
+    const SensorReading& data = record.reading;
     // post to api.thingspeak.com
-    if(isMotion) {
+    if(data.kind == SENSOR_PIR) {
         // send motion sensor data
         // http://api.thingspeak.com/update?api_key=[privateKey]&field1=[value]&field2=[value]
-        sprintf(buffer,
+        snprintf(buffer, size,
             "%s/update?api_key=%s&%s=%u&%s=%u", thingspeakServerUrl, tsPrivateKeyPIR,
             tsStationKey, data.stationCode, tsMotionKey, data.motion);
     } else {
         // send temp/humid/batt sensor data
         // http://api.thingspeak.com/update?api_key=[privateKey]&field1=[value]&field2=[value]&field3=[value]&field4=[value]
-        sprintf(buffer,
+        snprintf(buffer, size,
             "%s/update?api_key=%s&%s=%u&%s=%.1f&%s=%.1f&%s=%.1f", thingspeakServerUrl, tsPrivateKeyDHT,
             tsStationKey, data.stationCode, tsHumidityKey, data.humid, tsTempKey, data.temp, tsVoltageKey, data.batt);
     }
-    // write to db
-    doPost(buffer);
-    unsigned short posted = 1;
-    if(responseCode == 0) {
-        // if we got 0 in the responseCode, the post was not accepted (less than 15s): posted = 0
-        posted = 0;
+    if (record.createdAt != 0) {
+        // a stored reading posted again (see SensorBackfill.h): when it was received
+        char timeBuffer[32];
+        time_t createdAt = record.receivedTime();
+        strftime(timeBuffer, sizeof(timeBuffer), "%Y-%m-%dT%H:%M:%SZ", gmtime(&createdAt));
+        size_t length = strlen(buffer);
+        snprintf(buffer + length, size - length, "&created_at=%s", timeBuffer);
     }
-    // post to db (only when posting to thinkspeak for now)
-    postDb(posted);
+    return true;
 }
 
-void doPost(char buffer[]) {
-    printf("\n%s\n", buffer);
-    if(readyToSendToServer) {
-        curl_easy_setopt(curl, CURLOPT_URL, buffer);
+// thingspeak answers 0 when it did not take the post (less than 15s after the last one):
+// the db sink (next after this one, only after thingspeak for now) stores it with posted = 0
+bool thingspeakAccepted(const char* response) {
+    return atoi(response) != 0;
+}
 
-        /* Perform the request, res will get the return code */
-        res = curl_easy_perform(curl);
-        /* Check for errors */
-        if(res != CURLE_OK) {
-            fprintf(stderr, "curl_easy_perform() failed: %s\n", curl_easy_strerror(res));
+// one bulk update takes one channel: the readings of the same kind as the first one, as many as fit
+// http://api.thingspeak.com/channels/[channel]/bulk_update.json
+// {"write_api_key":"[privateKey]","updates":[{"created_at":"[time]","field1":[value],...},...]}
+unsigned int thingspeakBulk(const SensorRecord* records, unsigned int count,
+                            char* url, size_t urlSize, char* body, size_t bodySize) {
+    unsigned char kind = records[0].reading.kind;
+    snprintf(url, urlSize, "%s/channels/%s/bulk_update.json", thingspeakServerUrl,
+        kind == SENSOR_PIR ? tsChannelPIR : tsChannelDHT);
+    size_t length = snprintf(body, bodySize, "{\"write_api_key\":\"%s\",\"updates\":[",
+        kind == SENSOR_PIR ? tsPrivateKeyPIR : tsPrivateKeyDHT);
+    unsigned int taken = 0;
+    for (; taken < count && records[taken].reading.kind == kind; taken++) {
+        const SensorReading& data = records[taken].reading;
+        char timeBuffer[32];
+        time_t receivedAt = records[taken].receivedTime();
+        strftime(timeBuffer, sizeof(timeBuffer), "%Y-%m-%dT%H:%M:%SZ", gmtime(&receivedAt));
+        char update[MAXBUF];
+        if (kind == SENSOR_PIR) {
+            snprintf(update, sizeof(update), "%s{\"created_at\":\"%s\",\"%s\":%u,\"%s\":%u}",
+                taken > 0 ? "," : "", timeBuffer, tsStationKey, data.stationCode, tsMotionKey, data.motion);
+        } else {
+            snprintf(update, sizeof(update), "%s{\"created_at\":\"%s\",\"%s\":%u,\"%s\":%.1f,\"%s\":%.1f,\"%s\":%.1f}",
+                taken > 0 ? "," : "", timeBuffer, tsStationKey, data.stationCode,
+                tsHumidityKey, data.humid, tsTempKey, data.temp, tsVoltageKey, data.batt);
         }
+        // keep room for the closing ]}
+        if (length + strlen(update) + 3 > bodySize) {
+            break;
+        }
+        strcpy(body + length, update);
+        length += strlen(update);
     }
+    strcpy(body + length, "]}");
+    return taken;
 }
 
-void postDb(int posted) {
-    dbBuffer[0] = '\0';
-    if(isMotion) {
-        sprintf(dbBuffer, sqlInsertPIR, data.stationCode, motion, posted);
-    } else {
-        sprintf(dbBuffer, sqlInsertDHT, data.stationCode, data.temp, data.humid, data.batt, posted);
+// a bulk update answers {"success":true} when it was taken
+bool thingspeakBulkAccepted(const char* response) {
+    return strstr(response, "\"success\":true") != NULL;
+}
+
+bool postDb(SensorRecord& record) {
+    if (record.rowId != 0) {
+        // posted again: it is in the database already, the backfill marks it if it went through
+        backfill->done(record);
+        return true;
     }
-    puts(dbBuffer);
-    dbError = sqlite3_exec(dbConn, dbBuffer, 0, 0, 0);
-    if (dbError) {
+    if (!store.insert(record)) {
         puts("Can not insert into database");
+        return false;
     }
-}
\ No newline at end of file
+    return true;
+}
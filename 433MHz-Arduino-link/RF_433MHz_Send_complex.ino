@@ -16,11 +16,20 @@
     -- constrain final value between [0-1023] to make sure we don't exceed 10 bits
     -- receiver will have to divide by 10
   - motion sensor - 0=off/1=on.
+  The bit layout is in SensorPayload.h (copy it next to this sketch), which the
+  receivers decode with, so both sides always agree on it.
 
   There are 2 kinds of transmissions:
   - sender code + batt level + temp + humidity: once every 3 minutes using TimedAction (instead of delay or interrupts);
   - sender code + motion sensor: triggered on RISING interrupt on pin 2.
 
+  With USE_CRC every frame is followed by a CRC-8 of the 32 bits (40 bits in
+  total) so the receiver can drop frames that got corrupted on the way; comment
+  it out for a receiver that only takes 32 bit frames.
+  With USE_FEC as well the 40 bits are sent Hamming coded (47 bits): the receiver
+  corrects a wrong bit and fills in unreadable ones from a single repeat, so 5
+  repeats do what 15 did.
+
   DHT:
   - Connect pin 1 (on the left) of the sensor to +5V
   - Connect pin 2 of the sensor to whatever your DHTPIN is
@@ -50,10 +59,13 @@
 #include "DHT.h"
 #include "Arduino.h"
 #include <TimedAction.h>
+#include "SensorPayload.h"
 
 #define DHTPIN 3     // what pin is the DHT connected to
 #define DHTTYPE DHT22   // DHT 22  (AM2302)
 #define TXPIN 7     // what pin is the transmitter connected to
+#define USE_CRC     // send a CRC-8 after the 32 bits (see FrameCheck.h on the receiver)
+#define USE_FEC     // and Hamming code them (see HammingCode.h on the receiver), needs USE_CRC
 
 RCSwitch mySwitch = RCSwitch();
 DHT dht(DHTPIN, DHTTYPE);
@@ -83,7 +95,12 @@ void setup() {
 
   // optional set number of transmission repetitions - default is 10;
   // set to a higher value since in practice I noticed loss with distance
+#ifdef USE_FEC
+  // the receiver corrects most of what the extra repeats used to make up for
+  mySwitch.setRepeatTransmit(5);
+#else
   mySwitch.setRepeatTransmit(15);
+#endif
 
   dht.begin();
 }
@@ -97,18 +114,14 @@ void loop() {
 void transmitSensorData() {
   digitalWrite(txLed, HIGH);   // turn the LED on (HIGH is the voltage level)
 
-  // combined them in one long
-  combined = code;
-  combined = combined << 10 | temp;
-  combined = combined << 10 | humid;
-  combined = combined << 8 | batt;
+  // combined them in one long; values too big for their bits are sent as the largest that fits
+  combined = SensorPayload::dht(code, temp, humid, batt);
   
   Serial.print("DHT: ");
   Serial.println(combined);
 //  Serial.println(combined, BIN);
 
-  // send using decimal code
-  mySwitch.send(combined, 32);
+  sendCombined(combined);
   delay(1000);
   digitalWrite(txLed, LOW);    // turn the LED off by making the voltage LOW
 }
@@ -163,21 +176,72 @@ void transmitMotionData(byte motion) {
   digitalWrite(txLed, HIGH);   // turn the LED on (HIGH is the voltage level)
 
   // combined them in one long
-  combined = code;
-  combined = combined << 10 | 0;
-  combined = combined << 10 | 0;
-  combined = combined << 8 | motion;
+  combined = SensorPayload::pir(code, motion);
 
   Serial.print("PIR: ");
   Serial.println(combined);
 //  Serial.println(combined, BIN);
 
-  // send using decimal code
-  mySwitch.send(combined, 32);
+  sendCombined(combined);
   delay(1000);
   digitalWrite(txLed, LOW);    // turn the LED off by making the voltage LOW
 }
 
+// CRC-8 of the 32 bits, first bit first, polynomial x^8 + x^2 + x + 1
+byte crc8(unsigned long value) {
+  byte crc = 0;
+  for (int i = 31; i >= 0; i--) {
+    boolean top = ((crc >> 7) ^ (value >> i)) & 1;
+    crc = (crc << 1) ^ (top ? 0x07 : 0);
+  }
+  return crc;
+}
+
+// extended Hamming code of the 40 bits: 47 bits, positions 1..46 first (parity
+// bits at the powers of two, the data in between), then the parity of all of them
+unsigned long long hammingEncode(unsigned long long data) {
+  unsigned long long code = 0;
+  byte syndrome = 0;
+  byte nData = 40;
+  for (byte p = 1; p < 47; p++) {
+    if ((p & (p - 1)) != 0 && (data >> --nData) & 1) {
+      code |= 1ULL << (47 - p);
+      syndrome ^= p;
+    }
+  }
+  for (byte p = 1; p < 47; p <<= 1) {
+    if (syndrome & p) {
+      code |= 1ULL << (47 - p);
+    }
+  }
+  byte parity = 0;
+  for (byte i = 1; i < 47; i++) {
+    parity ^= (code >> i) & 1;
+  }
+  return code | parity;
+}
+
+void sendCombined(unsigned long value) {
+#ifdef USE_CRC
+  unsigned long long frame = (unsigned long long)value << 8 | crc8(value);
+  byte length = 40;
+#ifdef USE_FEC
+  frame = hammingEncode(frame);
+  length = 47;
+#endif
+  // send(value, length) takes at most 32 bits, a code word of '0' and '1' can be longer
+  char bits[48];
+  for (byte i = 0; i < length; i++) {
+    bits[i] = (frame >> (length - 1 - i)) & 1 ? '1' : '0';
+  }
+  bits[length] = '\0';
+  mySwitch.send(bits);
+#else
+  // send using decimal code
+  mySwitch.send(value, 32);
+#endif
+}
+
 void blinkMotionStart()
 {
   // replace interrupt handler with another one using FALLING
@@ -0,0 +1,67 @@
+/*
+  RingBuffer - bounded single-producer/single-consumer lock-free queue.
+
+  One thread may call push() and one (other) thread may call pop(); neither
+  side ever blocks or takes a lock, so the producer can be an interrupt
+  handler. The capacity N must be a power of two. When the buffer is full
+  push() fails and the item is dropped: the caller decides what to count.
+*/
+#ifndef _RingBuffer_h
+#define _RingBuffer_h
+
+#include <atomic>
+
+template <typename T, unsigned int N>
+class RingBuffer {
+
+  static_assert(N > 0 && (N & (N - 1)) == 0, "RingBuffer capacity must be a power of two");
+
+  public:
+    RingBuffer() : nHead(0), nTail(0) {}
+
+    /**
+     * Adds an item; producer side only.
+     *
+     * @return false if the buffer is full and the item was dropped
+     */
+    bool push(const T& item) {
+      unsigned int head = nHead.load(std::memory_order_relaxed);
+      if (head - nTail.load(std::memory_order_acquire) == N) {
+        return false;
+      }
+      items[head & (N - 1)] = item;
+      nHead.store(head + 1, std::memory_order_release);
+      return true;
+    }
+
+    /**
+     * Removes the oldest item; consumer side only.
+     *
+     * @return false if the buffer is empty
+     */
+    bool pop(T& item) {
+      unsigned int tail = nTail.load(std::memory_order_relaxed);
+      if (tail == nHead.load(std::memory_order_acquire)) {
+        return false;
+      }
+      item = items[tail & (N - 1)];
+      nTail.store(tail + 1, std::memory_order_release);
+      return true;
+    }
+
+    bool empty() const {
+      return nTail.load(std::memory_order_acquire) == nHead.load(std::memory_order_acquire);
+    }
+
+    unsigned int capacity() const {
+      return N;
+    }
+
+  private:
+    T items[N];
+    // head and tail are written by different threads: keep them on separate cache lines
+    alignas(64) std::atomic<unsigned int> nHead;
+    alignas(64) std::atomic<unsigned int> nTail;
+};
+
+#endif
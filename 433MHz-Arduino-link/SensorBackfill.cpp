@@ -0,0 +1,225 @@
+/*
+  SensorBackfill - posts the stored readings that did not get posted, again, see SensorBackfill.h
+*/
+
+#include "SensorBackfill.h"
+#include <stdio.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+#include <thread>
+#include <chrono>
+
+/**
+ * @param sink       Where the stored readings go again; its next sink must hand them back with done()
+ * @param nBatch     Rows pushed at once, at most BACKFILL_MAX_BATCH
+ * @param nInterval  Milliseconds between two batches, at least
+ */
+SensorBackfill::SensorBackfill(SensorSink* sink, unsigned int nBatch, unsigned int nInterval) {
+  this->sink = sink;
+  this->nBatch = nBatch < 1 ? 1 : nBatch > BACKFILL_MAX_BATCH ? BACKFILL_MAX_BATCH : nBatch;
+  this->nInterval = nInterval;
+  this->db = NULL;
+  this->tables[0] = Table { "dht", SENSOR_DHT, NULL, NULL, 0 };
+  this->tables[1] = Table { "pir", SENSOR_PIR, NULL, NULL, 0 };
+  this->nInFlight = 0;
+  this->nReplayed = 0;
+  this->nPosted = 0;
+}
+
+/**
+ * Opens the database, adds the indexes if needed and starts the thread.
+ *
+ * @return false if the database or its tables can not be used
+ */
+bool SensorBackfill::start(const char* sDbName) {
+  if (sqlite3_open(sDbName, &this->db) != SQLITE_OK) {
+    return false;
+  }
+  // the receiver writes to it at the same time
+  sqlite3_busy_timeout(this->db, 5000);
+  if (sqlite3_exec(this->db,
+                   "CREATE INDEX IF NOT EXISTS dht_unposted ON dht (id) WHERE posted = 0;"
+                   "CREATE INDEX IF NOT EXISTS pir_unposted ON pir (id) WHERE posted = 0;",
+                   0, 0, 0) != SQLITE_OK) {
+    fprintf(stderr, "backfill: %s\n", sqlite3_errmsg(this->db));
+    return false;
+  }
+  const char* selects[] = {
+    "SELECT id, station, temp, humidity, voltage, strftime('%s', created_date) FROM dht "
+    "WHERE posted = 0 AND id > ? ORDER BY id LIMIT ?",
+    "SELECT id, station, motion, 0, 0, strftime('%s', created_date) FROM pir "
+    "WHERE posted = 0 AND id > ? ORDER BY id LIMIT ?"
+  };
+  const char* updates[] = {
+    "UPDATE dht SET posted = 1 WHERE id = ?",
+    "UPDATE pir SET posted = 1 WHERE id = ?"
+  };
+  for (unsigned int t = 0; t < 2; t++) {
+    if (sqlite3_prepare_v2(this->db, selects[t], -1, &this->tables[t].select, NULL) != SQLITE_OK ||
+        sqlite3_prepare_v2(this->db, updates[t], -1, &this->tables[t].update, NULL) != SQLITE_OK) {
+      fprintf(stderr, "backfill: %s\n", sqlite3_errmsg(this->db));
+      return false;
+    }
+  }
+  std::thread worker(&SensorBackfill::run, this);
+  pthread_setname_np(worker.native_handle(), "backfill");
+  worker.detach();
+  return true;
+}
+
+/**
+ * Takes back a reading this pushed, with posted telling whether the service took it.
+ * Call it from the sink after the backfill's one, instead of storing the reading.
+ */
+void SensorBackfill::done(const SensorRecord& record) {
+  std::lock_guard<std::mutex> lock(this->doneMutex);
+  if (record.posted) {
+    this->postedIds[record.reading.kind == SENSOR_PIR ? 1 : 0].push_back(record.rowId);
+  }
+  if (this->nInFlight > 0) {
+    this->nInFlight--;
+  }
+  this->finished.notify_one();
+}
+
+/**
+ * Rows pushed to the sink again so far
+ */
+unsigned long SensorBackfill::getReplayed() {
+  std::lock_guard<std::mutex> lock(this->doneMutex);
+  return this->nReplayed;
+}
+
+/**
+ * Rows marked posted so far
+ */
+unsigned long SensorBackfill::getPosted() {
+  std::lock_guard<std::mutex> lock(this->doneMutex);
+  return this->nPosted;
+}
+
+/**
+ * Thread: marks what got posted, then pushes the next batch once the sink is
+ * idle and the last batch is done; sleeps a sweep when the tables are through.
+ */
+void SensorBackfill::run() {
+  SensorRecord records[BACKFILL_MAX_BATCH];
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(this->doneMutex);
+      this->finished.wait_for(lock, std::chrono::milliseconds(this->nInterval),
+                              [this] { return this->nInFlight == 0; });
+    }
+    this->markPosted();
+    {
+      std::lock_guard<std::mutex> lock(this->doneMutex);
+      if (this->nInFlight > 0) {
+        continue;
+      }
+    }
+    if (this->sink->getPending() > 0) {
+      continue;
+    }
+
+    unsigned int nCount = this->fetch(this->tables[0], records, this->nBatch);
+    nCount += this->fetch(this->tables[1], records + nCount, this->nBatch - nCount);
+    if (nCount == 0) {
+      // through both tables: start over later, with what failed again since
+      this->tables[0].lastId = 0;
+      this->tables[1].lastId = 0;
+      std::this_thread::sleep_for(std::chrono::milliseconds(BACKFILL_SWEEP));
+      continue;
+    }
+    {
+      std::lock_guard<std::mutex> lock(this->doneMutex);
+      this->nInFlight += nCount;
+      this->nReplayed += nCount;
+    }
+    for (unsigned int i = 0; i < nCount; i++) {
+      this->sink->push(records[i]);
+    }
+    // at most a batch every nInterval
+    std::this_thread::sleep_for(std::chrono::milliseconds(this->nInterval));
+  }
+}
+
+/**
+ * Reads the next unposted rows of a table after its cursor as SensorRecords.
+ *
+ * @return rows read, at most nMax
+ */
+unsigned int SensorBackfill::fetch(Table& table, SensorRecord* records, unsigned int nMax) {
+  if (nMax == 0) {
+    return 0;
+  }
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  unsigned long long receivedAt = now.tv_sec * 1000000ULL + now.tv_nsec / 1000;
+
+  sqlite3_stmt* select = table.select;
+  sqlite3_bind_int64(select, 1, table.lastId);
+  sqlite3_bind_int(select, 2, nMax);
+  unsigned int nCount = 0;
+  while (nCount < nMax && sqlite3_step(select) == SQLITE_ROW) {
+    SensorRecord& record = records[nCount++];
+    SensorReading& data = record.reading;
+    record.rowId = sqlite3_column_int64(select, 0);
+    data.kind = table.kind;
+    data.stationCode = sqlite3_column_int(select, 1);
+    if (table.kind == SENSOR_PIR) {
+      data.motion = sqlite3_column_int(select, 2);
+      data.temp = data.humid = data.batt = 0;
+      record.value = SensorPayload::pir(data.stationCode, data.motion);
+    } else {
+      data.motion = 0;
+      data.temp = sqlite3_column_double(select, 2);
+      data.humid = sqlite3_column_double(select, 3);
+      data.batt = sqlite3_column_double(select, 4);
+      record.value = SensorPayload::dht(data.stationCode, lround(data.temp * 10), lround(data.humid * 10),
+                                        lround(data.batt / 50));
+    }
+    record.createdAt = sqlite3_column_int64(select, 5);
+    // for the batch deadlines: it is new to the sink
+    record.receivedAt = receivedAt;
+    record.checked = false;
+    record.posted = 0;
+    table.lastId = record.rowId;
+  }
+  sqlite3_reset(select);
+  return nCount;
+}
+
+/**
+ * Marks the rows that got posted since the last pass, all in one transaction.
+ */
+void SensorBackfill::markPosted() {
+  std::vector<long long> ids[2];
+  {
+    std::lock_guard<std::mutex> lock(this->doneMutex);
+    ids[0].swap(this->postedIds[0]);
+    ids[1].swap(this->postedIds[1]);
+  }
+  if (ids[0].empty() && ids[1].empty()) {
+    return;
+  }
+  sqlite3_exec(this->db, "BEGIN", 0, 0, 0);
+  for (unsigned int t = 0; t < 2; t++) {
+    sqlite3_stmt* update = this->tables[t].update;
+    for (size_t i = 0; i < ids[t].size(); i++) {
+      sqlite3_bind_int64(update, 1, ids[t][i]);
+      if (sqlite3_step(update) != SQLITE_DONE) {
+        fprintf(stderr, "backfill: %s\n", sqlite3_errmsg(this->db));
+      }
+      sqlite3_reset(update);
+    }
+  }
+  if (sqlite3_exec(this->db, "COMMIT", 0, 0, 0) != SQLITE_OK) {
+    // left posted = 0: they are posted again next sweep
+    fprintf(stderr, "backfill: %s\n", sqlite3_errmsg(this->db));
+    sqlite3_exec(this->db, "ROLLBACK", 0, 0, 0);
+    return;
+  }
+  std::lock_guard<std::mutex> lock(this->doneMutex);
+  this->nPosted += ids[0].size() + ids[1].size();
+}
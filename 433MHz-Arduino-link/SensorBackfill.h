@@ -0,0 +1,76 @@
+/*
+  SensorBackfill - posts the stored readings that did not get posted, again.
+
+  The database sink stores every reading with posted = 0 when the service did
+  not take it (thingspeak's 15s limit, a timeout, a reading skipped to keep
+  up). This worker goes through those rows, oldest first, and pushes them to
+  the service's sink again, as a SensorRecord with rowId set: the database
+  sink must then not store it again but hand it back with done(), and the
+  rows that got posted are marked in one transaction per pass.
+
+  Live readings come first: a batch of nBatch rows is only pushed when the
+  sink has nothing waiting and the previous batch is done, at most one batch
+  every nInterval ms, so the backlog drains at the pace the service allows.
+  The rows are found through partial indexes on posted = 0, created here if
+  missing, and a cursor on the row id: a row that fails again waits for the
+  next sweep through the tables, BACKFILL_SWEEP ms after the last one ended.
+
+  It has its own connection to the database, and a thread for the process.
+*/
+#ifndef _SensorBackfill_h
+#define _SensorBackfill_h
+
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include <sqlite3.h>
+#include "SensorPipeline.h"
+
+// rows pushed at once, at most
+#define BACKFILL_MAX_BATCH 32
+
+// pause after a sweep found nothing more to post, in milliseconds
+#define BACKFILL_SWEEP 600000
+
+
+class SensorBackfill {
+
+  public:
+    SensorBackfill(SensorSink* sink, unsigned int nBatch, unsigned int nInterval);
+
+    bool start(const char* sDbName);
+    void done(const SensorRecord& record);
+
+    unsigned long getReplayed();
+    unsigned long getPosted();
+
+  private:
+    // dht and pir
+    struct Table {
+      const char* sName;
+      unsigned char kind;
+      sqlite3_stmt* select;
+      sqlite3_stmt* update;
+      long long lastId;     // the cursor: rows up to it were tried this sweep
+    };
+
+    void run();
+    unsigned int fetch(Table& table, SensorRecord* records, unsigned int nMax);
+    void markPosted();
+
+    SensorSink* sink;
+    unsigned int nBatch;
+    unsigned int nInterval;
+    sqlite3* db;
+    Table tables[2];
+
+    std::mutex doneMutex;
+    std::condition_variable finished;
+    unsigned int nInFlight;
+    // rows posted since the last markPosted(), per table
+    std::vector<long long> postedIds[2];
+    unsigned long nReplayed;
+    unsigned long nPosted;
+};
+
+#endif
@@ -0,0 +1,127 @@
+/*
+  SensorPayload - the layout of the 32 bit sensor frames, in one place for the
+  Arduino sketch that packs them and the receivers that unpack them.
+
+  A layout is a chain of fields declared by width only: the first one starts at
+  the top of the frame, next() puts a field right after the one before, so the
+  shifts and masks are worked out at compile time and a static_assert checks
+  that the fields fill the frame. A field's value is raw * multiplier / divisor:
+
+  +-----------------+---------------------+---------------------+-------------------+
+  | 4 bits station  | 10 bits temp F x10  | 10 bits humid % x10 | 8 bits batt mV/50 |   DHT
+  +-----------------+---------------------+---------------------+-------------------+
+  | 4 bits station  | 20 bits 0                                 | 8 bits motion 0/1 |   PIR
+  +-----------------+-------------------------------------------+-------------------+
+
+  To change a layout or add a kind, declare its fields below and extend
+  decode(); the sketch (RF_433MHz_Send_complex.ino) includes this file too,
+  which is why it sticks to C++11 (the Arduino IDE's dialect) and plain types.
+*/
+#ifndef _SensorPayload_h
+#define _SensorPayload_h
+
+// bits of a sensor frame, without the CRC (see FrameCheck.h)
+#define SENSOR_PAYLOAD_BITS 32
+
+// kinds of reading
+#define SENSOR_DHT 0
+#define SENSOR_PIR 1
+
+/**
+ * One field of a layout: bits wide, shift bits above the end of the frame.
+ */
+struct PayloadField {
+  unsigned char shift;
+  unsigned char bits;
+  unsigned int multiplier;
+  unsigned int divisor;
+
+  /**
+   * The first field of a layout, at the top of the frame
+   */
+  static constexpr PayloadField first(unsigned char nBits, unsigned int nMultiplier = 1, unsigned int nDivisor = 1) {
+    return PayloadField { (unsigned char)(SENSOR_PAYLOAD_BITS - nBits), nBits, nMultiplier, nDivisor };
+  }
+
+  /**
+   * The field right after this one
+   */
+  constexpr PayloadField next(unsigned char nBits, unsigned int nMultiplier = 1, unsigned int nDivisor = 1) const {
+    return PayloadField { (unsigned char)(shift - nBits), nBits, nMultiplier, nDivisor };
+  }
+
+  constexpr unsigned long mask() const {
+    return bits >= 32 ? 0xFFFFFFFFUL : (1UL << bits) - 1;
+  }
+
+  constexpr unsigned long raw(unsigned long frame) const {
+    return (frame >> shift) & mask();
+  }
+
+  constexpr float value(unsigned long frame) const {
+    return (float)raw(frame) * multiplier / divisor;
+  }
+
+  /**
+   * A raw value in place, the largest one that fits if it is too big
+   */
+  constexpr unsigned long pack(unsigned long nRaw) const {
+    return (nRaw > mask() ? mask() : nRaw) << shift;
+  }
+};
+
+/**
+ * A decoded frame. Only the fields of its kind are set, the others are 0.
+ */
+struct SensorReading {
+  unsigned char kind;           // SENSOR_DHT or SENSOR_PIR
+  unsigned char stationCode;    // 0..15
+  unsigned char motion;         // 0=off, 1=on
+  float temp;                   // F
+  float humid;                  // %
+  float batt;                   // mV
+};
+
+namespace SensorPayload {
+
+  // both kinds start with the station code
+  constexpr PayloadField station = PayloadField::first(4);
+
+  // DHT
+  constexpr PayloadField temp = station.next(10, 1, 10);
+  constexpr PayloadField humid = temp.next(10, 1, 10);
+  constexpr PayloadField batt = humid.next(8, 50, 1);
+
+  // PIR: 0 where the DHT has temperature and humidity
+  constexpr PayloadField pirZero = station.next(20);
+  constexpr PayloadField motion = pirZero.next(8);
+
+  static_assert(batt.shift == 0 && motion.shift == 0, "a layout must fill the frame exactly");
+
+  /**
+   * DHT frame from raw values: temperature and humidity x10, battery / 50
+   */
+  constexpr unsigned long dht(unsigned long nStation, unsigned long nTemp, unsigned long nHumid, unsigned long nBatt) {
+    return station.pack(nStation) | temp.pack(nTemp) | humid.pack(nHumid) | batt.pack(nBatt);
+  }
+
+  constexpr unsigned long pir(unsigned long nStation, unsigned long nMotion) {
+    return station.pack(nStation) | motion.pack(nMotion);
+  }
+
+  /**
+   * Kind of a frame: a DHT reading of 0 F and 0 % looks like PIR, as it always did
+   */
+  constexpr unsigned char kind(unsigned long frame) {
+    return pirZero.raw(frame) == 0 ? SENSOR_PIR : SENSOR_DHT;
+  }
+
+  constexpr SensorReading decode(unsigned long frame) {
+    return kind(frame) == SENSOR_PIR
+        ? SensorReading { SENSOR_PIR, (unsigned char)station.raw(frame), (unsigned char)motion.raw(frame), 0, 0, 0 }
+        : SensorReading { SENSOR_DHT, (unsigned char)station.raw(frame), 0,
+                          temp.value(frame), humid.value(frame), batt.value(frame) };
+  }
+}
+
+#endif
@@ -0,0 +1,293 @@
+/*
+  SensorPipeline - from decoded frames to the places the readings go, see SensorPipeline.h
+*/
+
+#include "SensorPipeline.h"
+#include <stdio.h>
+#include <pthread.h>
+#include <thread>
+#include <vector>
+
+/**
+ * When the reading was received, on the wall clock: receivedAt is CLOCK_MONOTONIC.
+ * For a stored reading posted again, when it was stored.
+ */
+time_t SensorRecord::receivedTime() const {
+  if (this->createdAt != 0) {
+    return (time_t)this->createdAt;
+  }
+  struct timespec monotonic;
+  clock_gettime(CLOCK_MONOTONIC, &monotonic);
+  unsigned long long now = monotonic.tv_sec * 1000000ULL + monotonic.tv_nsec / 1000;
+  return time(NULL) - (time_t)((now - this->receivedAt) / 1000000);
+}
+
+/**
+ * Creates a sink and starts its worker thread.
+ *
+ * @param sName      Name for the thread and the statistics; not copied
+ * @param handler    Delivers one reading, on the worker thread
+ * @param nCapacity  Readings that can wait, at least 1
+ * @param nPolicy    SINK_DROP_OLDEST, SINK_DROP_NEWEST or SINK_BLOCK when they are all taken
+ */
+SensorSink* SensorSink::create(const char* sName, Handler handler, unsigned int nCapacity, int nPolicy) {
+  SensorSink* sink = new SensorSink(sName, handler, nCapacity > 0 ? nCapacity : 1, nPolicy);
+  std::thread worker(&SensorSink::deliver, sink);
+  char name[16];
+  snprintf(name, sizeof(name), "sink-%s", sName);
+  pthread_setname_np(worker.native_handle(), name);
+  worker.detach();
+  return sink;
+}
+
+/**
+ * Creates a sink without a worker thread, for a driver that calls pop() and done().
+ */
+SensorSink* SensorSink::createQueue(const char* sName, unsigned int nCapacity, int nPolicy) {
+  return new SensorSink(sName, Handler(), nCapacity > 0 ? nCapacity : 1, nPolicy);
+}
+
+SensorSink::SensorSink(const char* sName, Handler handler, unsigned int nCapacity, int nPolicy) {
+  this->sName = sName;
+  this->handler = handler;
+  this->nCapacity = nCapacity;
+  this->nPolicy = nPolicy;
+  this->next = NULL;
+  this->nDelivered = 0;
+  this->nFailed = 0;
+  this->nDropped = 0;
+}
+
+/**
+ * Queues a reading for the worker; with SINK_BLOCK waits for room first.
+ *
+ * @return false if it was dropped (SINK_DROP_NEWEST); with SINK_DROP_OLDEST
+ *         it is always queued and an older one is dropped instead
+ */
+bool SensorSink::push(const SensorRecord& record) {
+  SensorRecord dropped;
+  bool bDropped = false;
+  {
+    std::unique_lock<std::mutex> lock(this->queueMutex);
+    if (this->records.size() >= this->nCapacity) {
+      if (this->nPolicy == SINK_BLOCK) {
+        this->room.wait(lock, [this] { return this->records.size() < this->nCapacity; });
+      } else if (this->nPolicy == SINK_DROP_OLDEST) {
+        dropped = this->records.front();
+        this->records.pop_front();
+        bDropped = true;
+      } else {
+        dropped = record;
+        bDropped = true;
+      }
+      if (bDropped) {
+        this->nDropped++;
+      }
+    }
+    if (!bDropped || this->nPolicy == SINK_DROP_OLDEST) {
+      this->records.push_back(record);
+      this->queued.notify_one();
+    }
+  }
+  // outside the lock: the next sink may block
+  if (bDropped && this->next != NULL) {
+    dropped.posted = 0;
+    this->next->push(dropped);
+  }
+  if (this->wakeup) {
+    this->wakeup();
+  }
+  return !bDropped || this->nPolicy == SINK_DROP_OLDEST;
+}
+
+/**
+ * Where each reading goes after this sink delivered it, failed to or dropped
+ * it, with posted set accordingly. Set it before the first push().
+ */
+void SensorSink::setNext(SensorSink* next) {
+  this->next = next;
+}
+
+/**
+ * Called after every push(), from the pushing thread. Set it before the first push().
+ */
+void SensorSink::setWakeup(std::function<void()> wakeup) {
+  this->wakeup = wakeup;
+}
+
+/**
+ * Takes the oldest waiting reading, for the driver of a createQueue() sink.
+ *
+ * @return false if none is waiting
+ */
+bool SensorSink::pop(SensorRecord& record) {
+  std::lock_guard<std::mutex> lock(this->queueMutex);
+  if (this->records.empty()) {
+    return false;
+  }
+  record = this->records.front();
+  this->records.pop_front();
+  this->room.notify_one();
+  return true;
+}
+
+/**
+ * Counts a reading taken with pop() as delivered or failed and passes it on to the next sink.
+ */
+void SensorSink::done(SensorRecord& record, bool bDelivered) {
+  {
+    std::lock_guard<std::mutex> lock(this->queueMutex);
+    if (bDelivered) {
+      this->nDelivered++;
+    } else {
+      this->nFailed++;
+    }
+  }
+  if (this->next != NULL) {
+    record.posted = bDelivered ? 1 : 0;
+    this->next->push(record);
+  }
+}
+
+/**
+ * Keeps only the newest waiting reading of each station and kind, the others
+ * are dropped (and passed on as not posted). Stored readings being posted
+ * again (SensorRecord::rowId) are history and all stay.
+ *
+ * @return readings dropped
+ */
+unsigned int SensorSink::coalesce() {
+  std::vector<SensorRecord> replaced;
+  {
+    std::lock_guard<std::mutex> lock(this->queueMutex);
+    bool newer[DEDUP_MAX_STATIONS][DEDUP_MAX_KINDS] = {};
+    // newest first: a reading is replaced if one of the same station and kind came after it
+    for (size_t i = this->records.size(); i-- > 0; ) {
+      SensorRecord& record = this->records[i];
+      unsigned int nStation = record.reading.stationCode;
+      unsigned int nKind = record.reading.kind;
+      if (record.rowId != 0 || nStation >= DEDUP_MAX_STATIONS || nKind >= DEDUP_MAX_KINDS) {
+        continue;
+      }
+      if (newer[nStation][nKind]) {
+        replaced.push_back(record);
+        this->records.erase(this->records.begin() + i);
+      } else {
+        newer[nStation][nKind] = true;
+      }
+    }
+    this->nDropped += replaced.size();
+    if (!replaced.empty()) {
+      this->room.notify_all();
+    }
+  }
+  // outside the lock: the next sink may block; oldest first
+  if (this->next != NULL) {
+    for (size_t i = replaced.size(); i-- > 0; ) {
+      replaced[i].posted = 0;
+      this->next->push(replaced[i]);
+    }
+  }
+  return replaced.size();
+}
+
+const char* SensorSink::getName() {
+  return this->sName;
+}
+
+/**
+ * Readings waiting, not counting the one being delivered
+ */
+unsigned int SensorSink::getPending() {
+  std::lock_guard<std::mutex> lock(this->queueMutex);
+  return this->records.size();
+}
+
+unsigned long SensorSink::getDelivered() {
+  std::lock_guard<std::mutex> lock(this->queueMutex);
+  return this->nDelivered;
+}
+
+unsigned long SensorSink::getFailed() {
+  std::lock_guard<std::mutex> lock(this->queueMutex);
+  return this->nFailed;
+}
+
+/**
+ * Readings dropped because the queue was full
+ */
+unsigned long SensorSink::getDropped() {
+  std::lock_guard<std::mutex> lock(this->queueMutex);
+  return this->nDropped;
+}
+
+/**
+ * Worker thread: hands the readings to the handler one at a time, oldest first.
+ */
+void SensorSink::deliver() {
+  while (true) {
+    SensorRecord record;
+    {
+      std::unique_lock<std::mutex> lock(this->queueMutex);
+      this->queued.wait(lock, [this] { return !this->records.empty(); });
+      record = this->records.front();
+      this->records.pop_front();
+      this->room.notify_one();
+    }
+    this->done(record, this->handler(record));
+  }
+}
+
+
+SensorPipeline::SensorPipeline() {
+  this->nSinks = 0;
+  for (unsigned int i = 0; i < SENSOR_MAX_SINKS; i++) {
+    this->sinks[i] = NULL;
+  }
+}
+
+/**
+ * Adds a sink every new reading is pushed to. A sink that only gets readings
+ * from another one (see SensorSink::setNext) is not added.
+ *
+ * @return false if there are SENSOR_MAX_SINKS already
+ */
+bool SensorPipeline::addSink(SensorSink* sink) {
+  if (sink == NULL || this->nSinks >= SENSOR_MAX_SINKS) {
+    return false;
+  }
+  this->sinks[this->nSinks++] = sink;
+  return true;
+}
+
+/**
+ * The duplicate check, e.g. to set its windows
+ */
+FrameDedup& SensorPipeline::getDedup() {
+  return this->dedup;
+}
+
+/**
+ * Decodes a 32 bit sensor frame and, unless it is a duplicate, pushes it to every sink.
+ *
+ * @param frame   A frame from RCSwitch::drain()
+ * @param record  Receives the decoded reading, duplicate or not
+ *
+ * @return true if the reading is new and was passed on
+ */
+bool SensorPipeline::process(const RCSwitchFrame& frame, SensorRecord& record) {
+  record.value = frame.value;
+  record.reading = SensorPayload::decode(record.value);
+  record.receivedAt = frame.receivedAt;
+  record.checked = frame.checked;
+  record.posted = 0;
+  record.rowId = 0;
+  record.createdAt = 0;
+  if (this->dedup.isDuplicate(record.reading.stationCode, record.reading.kind, record.value, record.receivedAt)) {
+    return false;
+  }
+  for (unsigned int i = 0; i < this->nSinks; i++) {
+    this->sinks[i]->push(record);
+  }
+  return true;
+}
@@ -0,0 +1,134 @@
+/*
+  SensorPipeline - from decoded frames to the places the readings go.
+
+    receiver thread     main loop                        one thread per sink
+    radio -> frames --> decode (SensorPayload.h)    +--> [queue] web service
+                        drop duplicates (FrameDedup) +--> [queue] broker --> [queue] database
+                        fan out ---------------------+--> ...
+
+  Decoding and the duplicate check take microseconds and run on the thread that
+  drains the receiver. Everything that can block (an HTTP post, the broker, the
+  database) is a SensorSink: its own worker thread behind a bounded queue, so a
+  web service that takes 10s to time out delays that service's next post and
+  nothing else.
+
+  What a sink does when its queue is full is chosen per sink:
+  - SINK_DROP_OLDEST: the oldest waiting reading goes, for posts where a fresh
+    reading is worth more than a late one;
+  - SINK_DROP_NEWEST: the new reading is refused;
+  - SINK_BLOCK: push() waits for room, for a sink that must not lose anything
+    (the database); whoever pushes slows down to its pace.
+
+  A sink created with createQueue() has no thread: whoever drives it takes the
+  readings with pop() and reports each with done(), e.g. HttpFanout runs all the
+  web services' requests from one event loop.
+
+  A sink can pass each reading on to a next one when it is done with it, with
+  SensorRecord::posted telling whether it succeeded (0 as well if it was
+  dropped): the database sink records every reading with the upload's outcome.
+
+  A sink that may only post so often (see HttpFanout::setRateLimit) can
+  coalesce() its queue while it waits: only the newest reading of each station
+  and kind stays, so the one posted next is the freshest, and the ones it
+  replaces go on to the next sink as not posted.
+
+  Sinks live as long as the process, like the receivers.
+*/
+#ifndef _SensorPipeline_h
+#define _SensorPipeline_h
+
+#include <time.h>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include "RCSwitchDecoder.h"
+#include "SensorPayload.h"
+#include "FrameDedup.h"
+
+// sinks one pipeline fans out to
+#define SENSOR_MAX_SINKS 8
+
+// what push() does when the queue is full
+#define SINK_DROP_OLDEST 0
+#define SINK_DROP_NEWEST 1
+#define SINK_BLOCK       2
+
+/**
+ * One reading on its way through the sinks.
+ */
+struct SensorRecord {
+    SensorReading reading;
+    unsigned long value;                // the frame as it was sent
+    unsigned long long receivedAt;      // CLOCK_MONOTONIC, in microseconds
+    bool checked;                       // it passed the CRC, see RCSwitchFrame
+    int posted;                         // 1 if the sink that passed it on succeeded
+    long long rowId;                    // a stored reading posted again (see SensorBackfill.h), 0 for a new one
+    long long createdAt;                // when that one was stored, in seconds since the epoch
+
+    time_t receivedTime() const;
+};
+
+
+class SensorSink {
+
+  public:
+    // returns false if the reading could not be delivered
+    typedef std::function<bool(SensorRecord& record)> Handler;
+
+    static SensorSink* create(const char* sName, Handler handler, unsigned int nCapacity, int nPolicy);
+    static SensorSink* createQueue(const char* sName, unsigned int nCapacity, int nPolicy);
+
+    bool push(const SensorRecord& record);
+    void setNext(SensorSink* next);
+    void setWakeup(std::function<void()> wakeup);
+
+    bool pop(SensorRecord& record);
+    void done(SensorRecord& record, bool bDelivered);
+    unsigned int coalesce();
+
+    const char* getName();
+    unsigned int getPending();
+    unsigned long getDelivered();
+    unsigned long getFailed();
+    unsigned long getDropped();
+
+  private:
+    SensorSink(const char* sName, Handler handler, unsigned int nCapacity, int nPolicy);
+
+    void deliver();
+
+    const char* sName;
+    Handler handler;
+    unsigned int nCapacity;
+    int nPolicy;
+    SensorSink* next;
+    // called after every push(), for a driver that sleeps
+    std::function<void()> wakeup;
+
+    std::mutex queueMutex;
+    std::condition_variable queued;
+    std::condition_variable room;
+    std::deque<SensorRecord> records;
+    unsigned long nDelivered;
+    unsigned long nFailed;
+    unsigned long nDropped;
+};
+
+
+class SensorPipeline {
+
+  public:
+    SensorPipeline();
+
+    bool addSink(SensorSink* sink);
+    FrameDedup& getDedup();
+    bool process(const RCSwitchFrame& frame, SensorRecord& record);
+
+  private:
+    FrameDedup dedup;
+    SensorSink* sinks[SENSOR_MAX_SINKS];
+    unsigned int nSinks;
+};
+
+#endif
@@ -0,0 +1,176 @@
+/*
+  SensorStore - writes the readings to the local database, see SensorStore.h
+*/
+
+#include "SensorStore.h"
+#include <stdio.h>
+#include <math.h>
+#include <pthread.h>
+#include <thread>
+
+SensorStore::SensorStore() {
+  this->db = NULL;
+  this->insertDHT = NULL;
+  this->insertPIR = NULL;
+  this->nBatch = STORE_DEFAULT_BATCH;
+  this->maxDelay = std::chrono::milliseconds(STORE_DEFAULT_DELAY);
+  this->nPending = 0;
+}
+
+/**
+ * Opens the database in WAL mode, prepares the inserts and starts the thread
+ * committing the groups on time.
+ *
+ * @param sDbName       The database file, with the dht and pir tables
+ * @param nSynchronous  STORE_SYNC_OFF, STORE_SYNC_NORMAL or STORE_SYNC_FULL
+ * @param nBatch        Rows committed together, at most; 1 commits every row
+ * @param nMaxDelay     Milliseconds a row waits for its group to be committed, at most
+ *
+ * @return false if the database or its tables can not be used
+ */
+bool SensorStore::open(const char* sDbName, int nSynchronous, unsigned int nBatch, unsigned int nMaxDelay) {
+  if (sqlite3_open(sDbName, &this->db) != SQLITE_OK) {
+    return false;
+  }
+  this->nBatch = nBatch < 1 ? 1 : nBatch;
+  this->maxDelay = std::chrono::milliseconds(nMaxDelay);
+  // other connections (the backfill) may hold the lock for a moment
+  sqlite3_busy_timeout(this->db, 5000);
+
+  char pragmas[128];
+  snprintf(pragmas, sizeof(pragmas), "PRAGMA journal_mode = WAL; PRAGMA synchronous = %d;", nSynchronous);
+  if (sqlite3_exec(this->db, pragmas, 0, 0, 0) != SQLITE_OK ||
+      sqlite3_prepare_v2(this->db,
+                         "INSERT INTO dht (station, temp, humidity, voltage, created_date, posted) "
+                         "VALUES (?, ?, ?, ?, datetime(?, 'unixepoch'), ?)",
+                         -1, &this->insertDHT, NULL) != SQLITE_OK ||
+      sqlite3_prepare_v2(this->db,
+                         "INSERT INTO pir (station, motion, created_date, posted) VALUES (?, ?, datetime(?, 'unixepoch'), ?)",
+                         -1, &this->insertPIR, NULL) != SQLITE_OK) {
+    fprintf(stderr, "store: %s\n", sqlite3_errmsg(this->db));
+    return false;
+  }
+  if (this->nBatch > 1) {
+    std::thread worker(&SensorStore::run, this);
+    pthread_setname_np(worker.native_handle(), "store");
+    worker.detach();
+  }
+  return true;
+}
+
+/**
+ * Adds a reading to the open group, and commits the group if it is full.
+ *
+ * @return false if it could not be written
+ */
+bool SensorStore::insert(const SensorRecord& record) {
+  std::lock_guard<std::mutex> lock(this->dbMutex);
+  if (this->db == NULL) {
+    return false;
+  }
+  if (this->nPending == 0 && this->nBatch > 1) {
+    if (sqlite3_exec(this->db, "BEGIN", 0, 0, 0) != SQLITE_OK) {
+      fprintf(stderr, "store: %s\n", sqlite3_errmsg(this->db));
+      return false;
+    }
+    this->startedAt = std::chrono::steady_clock::now();
+    this->started.notify_one();
+  }
+
+  const SensorReading& data = record.reading;
+  // when it was received, not when it got here behind the uploads
+  sqlite3_int64 receivedAt = record.receivedTime();
+  sqlite3_stmt* insert;
+  if (data.kind == SENSOR_PIR) {
+    insert = this->insertPIR;
+    sqlite3_bind_int(insert, 1, data.stationCode);
+    sqlite3_bind_int(insert, 2, data.motion);
+    sqlite3_bind_int64(insert, 3, receivedAt);
+    sqlite3_bind_int(insert, 4, record.posted);
+  } else {
+    insert = this->insertDHT;
+    // one decimal, as they were sent
+    sqlite3_bind_int(insert, 1, data.stationCode);
+    sqlite3_bind_double(insert, 2, round(data.temp * 10.0) / 10.0);
+    sqlite3_bind_double(insert, 3, round(data.humid * 10.0) / 10.0);
+    sqlite3_bind_double(insert, 4, round(data.batt * 10.0) / 10.0);
+    sqlite3_bind_int64(insert, 5, receivedAt);
+    sqlite3_bind_int(insert, 6, record.posted);
+  }
+  int nResult = sqlite3_step(insert);
+  sqlite3_reset(insert);
+  if (nResult != SQLITE_DONE) {
+    fprintf(stderr, "store: %s\n", sqlite3_errmsg(this->db));
+    if (this->nPending == 0 && this->nBatch > 1) {
+      sqlite3_exec(this->db, "ROLLBACK", 0, 0, 0);
+    }
+    return false;
+  }
+  if (this->nBatch > 1) {
+    this->nPending++;
+    if (this->nPending >= this->nBatch) {
+      return this->commit();
+    }
+  }
+  return true;
+}
+
+/**
+ * Commits the open group now.
+ */
+bool SensorStore::flush() {
+  std::lock_guard<std::mutex> lock(this->dbMutex);
+  return this->commit();
+}
+
+/**
+ * Commits the open group and closes the database.
+ */
+void SensorStore::close() {
+  std::lock_guard<std::mutex> lock(this->dbMutex);
+  if (this->db == NULL) {
+    return;
+  }
+  this->commit();
+  sqlite3_finalize(this->insertDHT);
+  sqlite3_finalize(this->insertPIR);
+  sqlite3_close(this->db);
+  this->db = NULL;
+  this->started.notify_one();
+}
+
+/**
+ * Thread: commits a group maxDelay after its first row, if it did not fill up before.
+ */
+void SensorStore::run() {
+  std::unique_lock<std::mutex> lock(this->dbMutex);
+  while (this->db != NULL) {
+    if (this->nPending == 0) {
+      this->started.wait(lock);
+      continue;
+    }
+    std::chrono::steady_clock::time_point due = this->startedAt + this->maxDelay;
+    if (std::chrono::steady_clock::now() < due) {
+      this->started.wait_until(lock, due);
+      continue;
+    }
+    this->commit();
+  }
+}
+
+/**
+ * Commits the open group, the lock held. A group that can not be committed
+ * (the database is busy) stays open and is tried again with the next row or on time.
+ */
+bool SensorStore::commit() {
+  if (this->db == NULL || this->nPending == 0) {
+    return true;
+  }
+  if (sqlite3_exec(this->db, "COMMIT", 0, 0, 0) != SQLITE_OK) {
+    fprintf(stderr, "store: %s\n", sqlite3_errmsg(this->db));
+    this->startedAt = std::chrono::steady_clock::now();
+    return false;
+  }
+  this->nPending = 0;
+  return true;
+}
@@ -0,0 +1,70 @@
+/*
+  SensorStore - writes the readings to the local database (sensors.db, tables
+  dht and pir, see readme.md) without an fsync per reading.
+
+  The two inserts are prepared once and the values bound, instead of SQL text
+  parsed for every reading. created_date is bound to when the reading was
+  received (SensorRecord::receivedTime) rather than left to the column default,
+  which is when it reached the store, behind the uploads that passed it on.
+
+  The database is switched to WAL mode, where a commit appends to the log
+  instead of rewriting pages, and the synchronous level can be lowered:
+  STORE_SYNC_NORMAL (the default) does not sync on every commit and still never
+  corrupts the database, a power cut only loses the last commits. Rows are
+  committed in groups: when nBatch are pending, or nMaxDelay ms after the first
+  one of the group, whichever comes first (a thread takes care of the second).
+  So on a crash at most the last nMaxDelay ms of insert() calls are lost, for
+  one commit instead of nBatch on the SD card; readings still queued in the
+  sinks ahead of the store are not covered.
+
+  The other connections to the database (SensorBackfill) read while it writes,
+  thanks to WAL, and wait up to 5s for a group to be committed.
+*/
+#ifndef _SensorStore_h
+#define _SensorStore_h
+
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <sqlite3.h>
+#include "SensorPipeline.h"
+
+// PRAGMA synchronous
+#define STORE_SYNC_OFF    0
+#define STORE_SYNC_NORMAL 1
+#define STORE_SYNC_FULL   2
+
+// group commit, until open() is told otherwise: rows and milliseconds
+#define STORE_DEFAULT_BATCH 32
+#define STORE_DEFAULT_DELAY 2000
+
+
+class SensorStore {
+
+  public:
+    SensorStore();
+
+    bool open(const char* sDbName, int nSynchronous = STORE_SYNC_NORMAL,
+              unsigned int nBatch = STORE_DEFAULT_BATCH, unsigned int nMaxDelay = STORE_DEFAULT_DELAY);
+    bool insert(const SensorRecord& record);
+    bool flush();
+    void close();
+
+  private:
+    void run();
+    bool commit();
+
+    sqlite3* db;
+    sqlite3_stmt* insertDHT;
+    sqlite3_stmt* insertPIR;
+    unsigned int nBatch;
+    std::chrono::milliseconds maxDelay;
+
+    // guards the connection and the group
+    std::mutex dbMutex;
+    std::condition_variable started;
+    unsigned int nPending;      // rows in the open transaction
+    std::chrono::steady_clock::time_point startedAt;
+};
+
+#endif
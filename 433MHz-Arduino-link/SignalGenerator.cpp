@@ -0,0 +1,144 @@
+/*
+  SignalGenerator - synthetic receiver input, see SignalGenerator.h
+*/
+
+#include "SignalGenerator.h"
+#include <algorithm>
+
+SignalGenerator::SignalGenerator(unsigned int nSeed) : random(nSeed) {
+}
+
+/**
+ * A clean 32 bit protocol 1 transmission, repeated like our senders do.
+ */
+SignalOptions SignalGenerator::defaults() {
+  SignalOptions options;
+  options.nProtocol = 1;
+  options.nPulseLength = 0;
+  options.nBits = 32;
+  options.nRepeats = 15;
+  options.nSilence = 20000;
+  options.jitter = 0.0;
+  options.dropRate = 0.0;
+  options.glitchRate = 0.0;
+  options.collisionRate = 0.0;
+  return options;
+}
+
+/**
+ * A random non zero code of nBits bits (the decoder never reports 0).
+ */
+unsigned long long SignalGenerator::randomCode(unsigned int nBits) {
+  unsigned long long mask = nBits >= 64 ? ~0ULL : (1ULL << nBits) - 1;
+  unsigned long long code;
+  do {
+    code = ((unsigned long long)this->random() << 32 | this->random()) & mask;
+  } while (code == 0);
+  return code;
+}
+
+/**
+ * Appends the high levels of one transmission starting at offset, with jitter.
+ *
+ * @return time at which the transmission ends (after the last sync gap)
+ */
+double SignalGenerator::highIntervals(const SignalOptions& options, unsigned long long code, double offset, std::vector<Interval>& highs) {
+  const RCSwitchProtocol* protocol = RCSwitchDecoder::getProtocol(options.nProtocol);
+  double delay = options.nPulseLength > 0 ? options.nPulseLength : protocol->pulseLength;
+  std::normal_distribution<double> jitter(0.0, options.jitter * delay);
+  double time = offset;
+
+  for (unsigned int nRepeat = 0; nRepeat < options.nRepeats; nRepeat++) {
+    for (int i = options.nBits; i >= 0; i--) {
+      // the bits, most significant first, then the sync
+      RCSwitchPulses pulses = i == 0 ? protocol->sync : ((code >> (i - 1)) & 1 ? protocol->one : protocol->zero);
+      double first = std::max(1.0, pulses.high * delay + (options.jitter > 0 ? jitter(this->random) : 0));
+      double second = std::max(1.0, pulses.low * delay + (options.jitter > 0 ? jitter(this->random) : 0));
+      Interval high;
+      if (protocol->inverted) {
+        high.start = time + first;
+        high.end = time + first + second;
+      } else {
+        high.start = time;
+        high.end = time + first;
+      }
+      highs.push_back(high);
+      time += first + second;
+    }
+  }
+  return time;
+}
+
+/**
+ * Generates the level durations the receiver sees for one transmission of code,
+ * starting with options.nSilence of quiet (ended by an edge, like the receiver's
+ * noise floor does).
+ *
+ * @param options     What to send and how to spoil it
+ * @param code        Value to send
+ * @param durations   Durations in microseconds are appended here
+ * @param collider    Set to the code of the colliding station, 0 if there was none
+ *
+ * @return true if another station collided with this transmission
+ */
+bool SignalGenerator::transmission(const SignalOptions& options, unsigned long long code,
+                                   std::vector<unsigned int>& durations, unsigned long long* collider) {
+  std::uniform_real_distribution<double> uniform(0.0, 1.0);
+  std::vector<Interval> highs;
+
+  double end = this->highIntervals(options, code, options.nSilence, highs);
+
+  *collider = 0;
+  if (options.collisionRate > 0 && uniform(this->random) < options.collisionRate) {
+    // the other station starts anywhere from half a transmission before to half after ours
+    double length = end - options.nSilence;
+    double offset = options.nSilence + (uniform(this->random) - 0.5) * length;
+    *collider = this->randomCode(options.nBits);
+    end = std::max(end, this->highIntervals(options, *collider, std::max(0.0, offset), highs));
+
+    // the receiver sees the union of both transmitters' highs
+    std::sort(highs.begin(), highs.end(), [](const Interval& a, const Interval& b) { return a.start < b.start; });
+    std::vector<Interval> merged;
+    for (const Interval& high : highs) {
+      if (!merged.empty() && high.start <= merged.back().end) {
+        merged.back().end = std::max(merged.back().end, high.end);
+      } else {
+        merged.push_back(high);
+      }
+    }
+    highs.swap(merged);
+  }
+
+  // alternate low/high levels, rounded to the microsecond like micros() does
+  std::vector<unsigned int> levels;
+  double time = 0;
+  for (const Interval& high : highs) {
+    levels.push_back((unsigned int)std::max(1.0, high.start - time));
+    levels.push_back((unsigned int)std::max(1.0, high.end - high.start));
+    time = high.end;
+  }
+  levels.push_back((unsigned int)std::max(1.0, end - time));
+
+  std::uniform_int_distribution<unsigned int> spike(10, 80);
+  for (size_t i = 0; i < levels.size(); i++) {
+    unsigned int level = levels[i];
+    if (options.dropRate > 0 && i + 1 < levels.size() && uniform(this->random) < options.dropRate) {
+      // edge at the end of this level missed: it runs into the next one
+      levels[i + 1] += level;
+      continue;
+    }
+    if (options.glitchRate > 0 && uniform(this->random) < options.glitchRate) {
+      // a spike of the other level somewhere inside this one
+      unsigned int width = spike(this->random);
+      if (level > width + 2) {
+        unsigned int before = 1 + (unsigned int)(uniform(this->random) * (level - width - 2));
+        durations.push_back(before);
+        durations.push_back(width);
+        durations.push_back(level - width - before);
+        continue;
+      }
+    }
+    durations.push_back(level);
+  }
+  return *collider != 0;
+}
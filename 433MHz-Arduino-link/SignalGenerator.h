@@ -0,0 +1,55 @@
+/*
+  SignalGenerator - synthetic receiver input for testing and benchmarking the decoder.
+
+  Produces the level durations a receiver would see for one transmission, built
+  from the same protocol waveforms RCSwitch sends (the bits, then the sync, the
+  whole thing repeated), and spoils them the way the air does:
+  - jitter: every level is stretched or shortened by a random amount
+  - dropped edges: an edge is missed, so two levels merge into one
+  - glitches: short noise spikes of the opposite level
+  - collisions: another station transmits at an overlapping time; the receiver
+    sees a high whenever either transmitter is high
+*/
+#ifndef _SignalGenerator_h
+#define _SignalGenerator_h
+
+#include <vector>
+#include <random>
+#include "RCSwitchDecoder.h"
+
+struct SignalOptions {
+    int nProtocol;
+    unsigned int nPulseLength;  // microseconds, 0 for the protocol default
+    unsigned int nBits;
+    unsigned int nRepeats;
+    unsigned int nSilence;      // microseconds of quiet before the transmission
+    double jitter;              // standard deviation of each level, fraction of the pulse length
+    double dropRate;            // probability of missing each edge
+    double glitchRate;          // probability of a spike in each level
+    double collisionRate;       // probability that another station overlaps the transmission
+};
+
+
+class SignalGenerator {
+
+  public:
+    SignalGenerator(unsigned int nSeed);
+
+    static SignalOptions defaults();
+
+    unsigned long long randomCode(unsigned int nBits);
+    bool transmission(const SignalOptions& options, unsigned long long code,
+                      std::vector<unsigned int>& durations, unsigned long long* collider);
+
+  private:
+    struct Interval {
+        double start;
+        double end;
+    };
+
+    double highIntervals(const SignalOptions& options, unsigned long long code, double offset, std::vector<Interval>& highs);
+
+    std::mt19937 random;
+};
+
+#endif
@@ -7,10 +7,12 @@
   - 8 bit: battery voltage in mV /50 (to get some decimals) -> need to multiply by 50
 
   Because the data is sent repeatedly, we need to make sure we don't get duplicates.
-  So we store the last value received and if we get it again in the next 30s, we
-  consider it a duplicate. The temp, humidity and voltage values are sent every few minutes
-  that's why we limit the check to 30s: if we receive the same value after 30s, we
-  consider it a new value - this is possible if none of tem, humidity or voltage changed.
+  So for each station we store the last temp/humidity/voltage value and the last motion
+  value received (see FrameDedup.h) and if the station sends it again in the next 30s, we
+  consider it a duplicate; other stations transmitting in between don't matter. The temp,
+  humidity and voltage values are sent every few minutes that's why we limit the check to
+  30s: if we receive the same value after 30s, we consider it a new value - this is
+  possible if none of tem, humidity or voltage changed.
 
   For the motion sensor, things are different: we don't check the sensor periodically,
   the Arduino code reacts using interrupts so there is no interval to use to check
@@ -18,6 +20,7 @@
   a message with motion=1; then the sensor is not triggered again until it resets (a few
   seconds); when it resets, we get a message with motion=0 so the value will be different.
   Then if the sensor is triggered again, we get motion=1 - a new value. And so on.
+  So motion values are only remembered for 5s, long enough to drop a repeated burst.
 
   This version of the code removes all the code posting to IoT services - that code is for
   now only in RFRcvCmplxData.cpp.
@@ -25,42 +28,30 @@
   The main purpose of this code is to post data to a localhost mosquitto broker so node-red
   can be used to get the data from mosquitto and do the rest of the work. In addition, I will
   save to a local db, with a posted flag = 1 (if publish was successful), 0 otherwise.
+
+  Usage: RFMqttRcvCmplxData [capture file]
+         RFMqttRcvCmplxData -i <capture file or pipe> - see RFRcvCmplxData.cpp
 */
 
 #include "../RCSwitch.h"
+#include "../SensorPipeline.h"
+#include "../SensorStore.h"
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <time.h>
-#include <sqlite3.h>
 #include <mosquitto.h>
 
-#define MAXBUF 512
-
-void postData();
-void postDb(int posted);
+bool postDb(SensorRecord& record);
 // mosquitto related methods
 static void die(const char *msg);
 static bool set_callbacks(struct mosquitto *m);
-int postMosquitto(struct mosquitto *m);
+int postMosquitto(struct mosquitto *m, SensorRecord& record);
 static struct mosquitto *init();
-void mqttPublish();
-
-struct Data
-{
-    unsigned char stationCode, motion;
-    float temp, humid, batt;
-};
+bool mqttPublish(SensorRecord& record);
 
 RCSwitch mySwitch;
 
-unsigned char t1, t4, stationCode, motion = 0;
-unsigned short t2, t3 = 0;
-float temp, humid, batt = 0;
-
-bool isMotion = false;
-
-struct Data data;
-
 // MQTT related
 #define BROKER_HOSTNAME "localhost"
 #define BROKER_PORT 1883
@@ -73,23 +64,18 @@ struct Data data;
 //struct tm * timeinfo;
 //char timeBuffer[80];
 
-sqlite3 *dbConn;
+// every reading goes in with whether it got published, committed a group at a time (see SensorStore.h)
+SensorStore store;
 bool dbConnectionOK = true;
-sqlite3_stmt *dbRes;
-int dbError;
-char dbBuffer[MAXBUF];
-char sqlInsertDHT[] = "INSERT INTO dht (station, temp, humidity, voltage, posted) values(%u, %.1f, %.1f, %.1f, %u)";
-char sqlInsertPIR[] = "INSERT INTO pir (station, motion, posted) values(%u, %u, %u)";
 
 // test data
-unsigned int value = 4026531841;   //15-0-0-1
+//unsigned int value = 4026531841;   //15-0-0-1
 
 char mosqId[30];
 struct mosquitto *mosq = NULL;
 
 int main(int argc, char *argv[]) {
 
-    float startTime = clock();
 
     mosq = init();
     // this code needs to post to mosquitto, if can't connect stop right away
@@ -102,17 +88,30 @@ int main(int argc, char *argv[]) {
 		return 1;
 	}
 
-    dbError = sqlite3_open("sensors.db", &dbConn);
-    if (dbError) {
+    if (!store.open("sensors.db", STORE_SYNC_NORMAL, 32, 2000)) {
         puts("Can not open database");
         dbConnectionOK = false;
     }
 
-    // we get lots of duplicates in the same transmission so we'll remember
-    // the last value received so we don't react twice to the same value
+    // publishing and the database each get their own thread and queue (see SensorPipeline.h)
+    // so neither holds up the radio; the database stores every reading after the broker
+    // had it, with whether it got published, and makes publishing wait rather than lose one
+    SensorSink* mqttSink = SensorSink::create("mqtt", mqttPublish, 32, SINK_DROP_OLDEST);
+    if(dbConnectionOK) {
+        mqttSink->setNext(SensorSink::create("db", postDb, 64, SINK_BLOCK));
+    }
+    SensorPipeline pipeline;
+    pipeline.addSink(mqttSink);
+
+    // we get lots of duplicates so we'll remember the last value each station
+    // sent of each kind so we don't react twice to the same value
     // however, if more than 30s passed more than likely this is a new
     // transmission so treat it as a new value so it gets posted (see if below)
-    unsigned int lastValue = 0;
+    FrameDedup& dedup = pipeline.getDedup();
+    dedup.setWindow(SENSOR_DHT, 30000);
+    dedup.setWindow(SENSOR_PIR, 5000);
+    unsigned long suppressedFrames = 0;
+    unsigned long droppedReadings = 0;
 
      // This pin is not the first pin on the RPi GPIO header!
      // Consult https://projects.drogon.net/raspberry-pi/wiringpi/pins/
@@ -123,82 +122,79 @@ int main(int argc, char *argv[]) {
        return 0;
 
      mySwitch = RCSwitch();
-     mySwitch.enableReceive(PIN);
+     if (argc > 2 && strcmp(argv[1], "-i") == 0) {
+       // decode a capture (or a pipe fed with one) instead of the radio
+       mySwitch.enableReceive(new FileEdgeSource(argv[2]));
+     } else {
+       mySwitch.enableReceive(PIN);
+       // optional: record every edge the radio sees, to replay it later with RCReplay
+       if (argc > 1 && !mySwitch.startCapture(argv[1])) {
+         fprintf(stderr, "Can not create capture file %s\n", argv[1]);
+       }
+     }
+     // the first 4 bits are the station code: learn each Arduino's pulse widths
+     mySwitch.setStationBits(4);
+     // a sketch with USE_CRC sends 40 bits: the 32 bit reading and a CRC-8 of it;
+     // the decoder drops the frames where it does not match and hands us the 32 bits
+     mySwitch.setCheckedBitlength(40);
+     // with USE_FEC as well those 40 bits come Hamming coded in 47: the decoder corrects them first
+     mySwitch.setCodedBitlength(47);
+     unsigned long corruptFrames = 0;
+
+     // several stations may transmit back to back: take every frame decoded since the last pass
+     RCSwitchFrame frames[RCSWITCH_FRAME_BUFFER];
 
      while(1) {
 
-      if (mySwitch.available()) {
+      // sleep until the decoder queues a frame; wake up now and then anyway to report the CRC failures
+      mySwitch.waitAvailable(10000);
+      unsigned int frameCount = mySwitch.drain(frames, RCSWITCH_FRAME_BUFFER);
+      for (unsigned int f = 0; f < frameCount; f++) {
 
-        value = mySwitch.getReceivedValue();
-
-        float crtTime = clock();
+        // the sensor frames are 32 bits (after the CRC is removed), anything else (a remote, a longer frame) is not ours
+        if (frames[f].bitlength != 32) {
+          printf("\nReceived %llu / %ubit, not a sensor frame\n", frames[f].value, frames[f].bitlength);
+          continue;
+        }
+        unsigned int value = frames[f].value;
 
         if (value == 0) {
           printf("Unknown encoding");
         } else {
-          if(value == lastValue && (crtTime-startTime)/CLOCKS_PER_SEC < 30) {
-              // nothing to do, it's a duplicate that came in less than 30s
+          // decoded with the bit layout in SensorPayload.h, shared with the Arduino sketch;
+          // a new reading is queued for publishing
+          SensorRecord record;
+          if(!pipeline.process(frames[f], record)) {
+              // nothing to do, it's a duplicate this station sent less than the window ago
               // printf("Duplicate value\n");
           } else {
-              //printf("%f\n", (crtTime - startTime)/CLOCKS_PER_SEC);
-              // reset the startTime
-              startTime = clock();
-
-              printf("\nReceived %u\n", value);
-              // display each simple value combined in the 32 bit uint
-              // first value takes only 4 bits so shift by 28
-              t1 = value >> 28;
-              // second value uses 10 bits: if we shift by 18 (4 first value, 10 this value),
-              // we'll end up with 14 bits but we are interested only in last 10 so 0 the others
-              t2 = value >> 18 & 0x3FF;   // 3FF = 00001111111111
-              // third value uses 10 bits: if we shift by 8 (4 first value, 10 second value, 10 this value),
-              // we'll end up with 14 bits but we are interested only in last 10 so 0 the others
-              t3 = value >> 8 & 0x3FF;   // 3FF = 00001111111111
-              // last value is the last byte, forcing a convertion from int to byte will get the value
-              t4 = value;
-              printf("raw values: %u-%i-%i-%i\n", t1, t2, t3, t4);
-
-              data.stationCode = 0;
-              data.motion = 0;
-              data.temp = 0.0;
-              data.humid = 0.0;
-              data.batt = 0.0;
-
-              // if t2 and t3 are 0, it's motion sensor data; otherwise is temp/humid/batt
-              if(t2 == 0 && t3 == 0) {
-                  isMotion = true;
-                  // real values
-                  stationCode = t1;    // numeric code 0-15
-                  motion = t4;         // 0=off,1=on
-                  printf("single values: %u-%u\n", stationCode, motion);
-                  data.stationCode = stationCode;
-                  data.motion = motion;
-                  postData();
+              SensorReading& data = record.reading;
+              printf("\nReceived %u%s\n", value, frames[f].checked ? " (CRC ok)" : "");
+              if(data.kind == SENSOR_PIR) {
+                  printf("single values: %u-%u\n", data.stationCode, data.motion);
               } else {
-                  isMotion = false;
-                  // real values
-                  stationCode = t1;    // numeric code 0-15
-                  temp = t2 / 10.0;    // F
-                  humid = t3 / 10.0;   // %
-                  batt = t4 * 50.0;    // mV
-                  printf("single values: %u-%.1f-%.1f-%.1f\n", stationCode, temp, humid, batt);
-                  data.stationCode = stationCode;
-                  data.temp = temp;
-                  data.humid = humid;
-                  data.batt = batt;
-                  postData();
+                  printf("single values: %u-%.1f-%.1f-%.1f\n", data.stationCode, data.temp, data.humid, data.batt);
               }
-
-              // store the new value as lastValue
-              lastValue = value;
           }
         }
+      }
+
+      if (mySwitch.getCorruptFrames() != corruptFrames || dedup.getSuppressed() != suppressedFrames) {
+        corruptFrames = mySwitch.getCorruptFrames();
+        suppressedFrames = dedup.getSuppressed();
+        printf("%lu frames failed the CRC, %lu passed, %lu bits corrected; duplicates dropped: %lu dht, %lu pir\n",
+               corruptFrames, mySwitch.getCheckedFrames(), mySwitch.getCorrectedBits(),
+               dedup.getSuppressed(SENSOR_DHT), dedup.getSuppressed(SENSOR_PIR));
+      }
 
-        mySwitch.resetAvailable();
+      if (mqttSink->getDropped() != droppedReadings) {
+        droppedReadings = mqttSink->getDropped();
+        printf("%s: %lu published, %lu failed, %lu skipped to keep up, %u waiting\n", mqttSink->getName(),
+               mqttSink->getDelivered(), mqttSink->getFailed(), mqttSink->getDropped(), mqttSink->getPending());
       }
     }
 
-    sqlite3_close(dbConn);
+    store.close();
 
     mosquitto_destroy(mosq);
     mosquitto_lib_cleanup();
@@ -206,38 +202,19 @@ int main(int argc, char *argv[]) {
     exit(0);
 }
 
-void postData()
-{
+// the db sink (next after this one) stores the reading with the posted flag according to mqtt publish success
+bool mqttPublish(SensorRecord& record) {
     // mosquitto publish
     printf("publish to mosquitto and db\n");
-    mqttPublish();
+    return postMosquitto(mosq, record) == MOSQ_ERR_SUCCESS;
 }
 
-void mqttPublish() {
-    int res = postMosquitto(mosq);
-    unsigned short publishSuccess = 1;
-    if (res != MOSQ_ERR_SUCCESS) {
-        publishSuccess = 0;
-    }
-    // post to db with the posted flag according to mqtt publish success
-    if(dbConnectionOK) {
-        // TODO save to db later
-        postDb(publishSuccess);
-    }
-}
-
-void postDb(int posted) {
-    dbBuffer[0] = '\0';
-    if(isMotion) {
-        sprintf(dbBuffer, sqlInsertPIR, data.stationCode, motion, posted);
-    } else {
-        sprintf(dbBuffer, sqlInsertDHT, data.stationCode, data.temp, data.humid, data.batt, posted);
-    }
-    puts(dbBuffer);
-    dbError = sqlite3_exec(dbConn, dbBuffer, 0, 0, 0);
-    if (dbError) {
+bool postDb(SensorRecord& record) {
+    if (!store.insert(record)) {
         puts("Can not insert into database");
+        return false;
     }
+    return true;
 }
 
 // mosquitto related methods
@@ -317,14 +294,14 @@ static bool set_callbacks(struct mosquitto *m) {
 // TODO apparently, I should use mosquitto_loop or mosquitto_loop_start to make sure all messages are published
 // let's get it to work without it at first and look at this later
 
-int postMosquitto(struct mosquitto *m) {
+int postMosquitto(struct mosquitto *m, SensorRecord& record) {
 
     // value is 32 bit, allow room for the terminating null byte ('\0'))
     size_t payload_sz = 33;
     char payload[payload_sz];
     size_t payloadlen = 0;
     // the message is the entire value received
-    payloadlen = snprintf(payload, payload_sz, "%u", value);
+    payloadlen = snprintf(payload, payload_sz, "%lu", record.value);
 //    if (payload_sz < payloadlen) { die("snprintf payload\n"); }
 
     // topic name is stations/<station_code>/pir or station/<station_code>/dht
@@ -332,10 +309,10 @@ int postMosquitto(struct mosquitto *m) {
     size_t topic_sz = 16;
     char topic[topic_sz];
     size_t topiclen = 0;
-    if(isMotion) {
-        topiclen = snprintf(topic, topic_sz, "%s/%u/%s",  TOPIC_STATIONS, data.stationCode, TOPIC_MOTION);
+    if(record.reading.kind == SENSOR_PIR) {
+        topiclen = snprintf(topic, topic_sz, "%s/%u/%s",  TOPIC_STATIONS, record.reading.stationCode, TOPIC_MOTION);
     } else {
-        topiclen = snprintf(topic, topic_sz, "%s/%u/%s",  TOPIC_STATIONS, data.stationCode, TOPIC_SENSORS);
+        topiclen = snprintf(topic, topic_sz, "%s/%u/%s",  TOPIC_STATIONS, record.reading.stationCode, TOPIC_SENSORS);
     }
 //    if (topic_sz < topiclen) { die("snprintf topic\n"); }
 